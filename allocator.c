@@ -0,0 +1,263 @@
+#include "allocator.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thread.h"
+
+// put in front of every block of the accounting allocator, so frees know what they give back.
+typedef union
+{
+  struct
+  {
+    size_t size;
+    allocator_stage stage;
+  } info;
+  max_align_t align;
+} block_header;
+
+// indexed by stage, the last one holds the totals.
+typedef struct
+{
+  atomic_uint_fast64_t live_bytes;
+  atomic_uint_fast64_t peak_bytes;
+  atomic_uint_fast64_t allocation_count;
+  atomic_uint_fast64_t free_count;
+} stage_stats;
+
+static void *default_malloc(size_t size, void *user)
+{
+  (void) user;
+  return malloc(size);
+}
+
+static void *default_calloc(size_t count, size_t size, void *user)
+{
+  (void) user;
+  return calloc(count, size);
+}
+
+static void *default_realloc(void *ptr, size_t size, void *user)
+{
+  (void) user;
+  return realloc(ptr, size);
+}
+
+static void default_free(void *ptr, void *user)
+{
+  (void) user;
+  free(ptr);
+}
+
+static const allocator_hooks default_hooks = {default_malloc, default_calloc, default_realloc, default_free, NULL};
+
+static allocator_hooks hooks = {default_malloc, default_calloc, default_realloc, default_free, NULL};
+// set by the first allocation, the hooks can't change afterwards. blocks already allocated (e.g. mxml's per-thread
+// globals) would otherwise be freed through hooks that didn't allocate them.
+static atomic_int hooks_used;
+
+// what the accounting allocator allocates from.
+static allocator_hooks accounting_base;
+static atomic_int accounting;
+static stage_stats stats[ALLOCATOR_STAGE_COUNT + 1];
+
+static THREAD_LOCAL allocator_stage local_stage;
+
+static void mark_hooks_used(void)
+{
+  // checked first so allocations don't keep writing the shared flag.
+  if (!atomic_load_explicit(&hooks_used, memory_order_relaxed))
+    atomic_store_explicit(&hooks_used, 1, memory_order_relaxed);
+}
+
+static void add_live_bytes(stage_stats *s, uint64_t size)
+{
+  uint64_t live_bytes = atomic_fetch_add(&s->live_bytes, size) + size;
+  uint64_t peak_bytes = atomic_load(&s->peak_bytes);
+  while (live_bytes > peak_bytes && !atomic_compare_exchange_weak(&s->peak_bytes, &peak_bytes, live_bytes))
+    ;
+}
+
+static void account_allocation(allocator_stage stage, size_t size)
+{
+  stage_stats *targets[2] = {&stats[stage], &stats[ALLOCATOR_STAGE_COUNT]};
+  for (int i = 0; i < 2; ++i)
+  {
+    add_live_bytes(targets[i], size);
+    atomic_fetch_add(&targets[i]->allocation_count, 1);
+  }
+}
+
+static void account_free(allocator_stage stage, size_t size)
+{
+  stage_stats *targets[2] = {&stats[stage], &stats[ALLOCATOR_STAGE_COUNT]};
+  for (int i = 0; i < 2; ++i)
+  {
+    atomic_fetch_sub(&targets[i]->live_bytes, size);
+    atomic_fetch_add(&targets[i]->free_count, 1);
+  }
+}
+
+static void *finish_block(block_header *header, size_t size)
+{
+  if (header == NULL)
+    return NULL;
+
+  header->info.size = size;
+  header->info.stage = local_stage;
+  account_allocation(local_stage, size);
+  return header + 1;
+}
+
+static void *accounting_malloc(size_t size, void *user)
+{
+  const allocator_hooks *base = (const allocator_hooks*) user;
+  if (size > SIZE_MAX - sizeof(block_header))
+    return NULL;
+  return finish_block((block_header*) base->malloc_fn(sizeof(block_header) + size, base->user), size);
+}
+
+static void *accounting_calloc(size_t count, size_t size, void *user)
+{
+  const allocator_hooks *base = (const allocator_hooks*) user;
+  if (size != 0 && count > (SIZE_MAX - sizeof(block_header)) / size)
+    return NULL;
+  return finish_block((block_header*) base->calloc_fn(1, sizeof(block_header) + count * size, base->user), count * size);
+}
+
+static void *accounting_realloc(void *ptr, size_t size, void *user)
+{
+  const allocator_hooks *base = (const allocator_hooks*) user;
+  if (ptr == NULL)
+    return accounting_malloc(size, user);
+  if (size > SIZE_MAX - sizeof(block_header))
+    return NULL;
+
+  // the block keeps the stage it was first allocated in.
+  block_header *header = (block_header*) ptr - 1;
+  size_t old_size = header->info.size;
+  allocator_stage stage = header->info.stage;
+  header = (block_header*) base->realloc_fn(header, sizeof(block_header) + size, base->user);
+  if (header == NULL)
+    return NULL;
+  header->info.size = size;
+
+  stage_stats *targets[2] = {&stats[stage], &stats[ALLOCATOR_STAGE_COUNT]};
+  for (int i = 0; i < 2; ++i)
+  {
+    if (size > old_size)
+      add_live_bytes(targets[i], size - old_size);
+    else
+      atomic_fetch_sub(&targets[i]->live_bytes, old_size - size);
+  }
+  return header + 1;
+}
+
+static void accounting_free(void *ptr, void *user)
+{
+  const allocator_hooks *base = (const allocator_hooks*) user;
+  if (ptr == NULL)
+    return;
+
+  block_header *header = (block_header*) ptr - 1;
+  account_free(header->info.stage, header->info.size);
+  base->free_fn(header, base->user);
+}
+
+int allocator_set_hooks(const allocator_hooks *new_hooks)
+{
+  if (new_hooks == NULL)
+    new_hooks = &default_hooks;
+  if (new_hooks->malloc_fn == NULL || new_hooks->calloc_fn == NULL || new_hooks->realloc_fn == NULL ||
+      new_hooks->free_fn == NULL || atomic_load(&hooks_used))
+    return -1;
+
+  hooks = *new_hooks;
+  atomic_store(&accounting, 0);
+  return 0;
+}
+
+int allocator_set_accounting(const allocator_hooks *base_hooks)
+{
+  if (base_hooks == NULL)
+    base_hooks = &default_hooks;
+  if (base_hooks->malloc_fn == NULL || base_hooks->calloc_fn == NULL || base_hooks->realloc_fn == NULL ||
+      base_hooks->free_fn == NULL || atomic_load(&hooks_used))
+    return -1;
+
+  for (int i = 0; i <= ALLOCATOR_STAGE_COUNT; ++i)
+  {
+    atomic_store(&stats[i].live_bytes, 0);
+    atomic_store(&stats[i].peak_bytes, 0);
+    atomic_store(&stats[i].allocation_count, 0);
+    atomic_store(&stats[i].free_count, 0);
+  }
+
+  accounting_base = *base_hooks;
+  hooks.malloc_fn = accounting_malloc;
+  hooks.calloc_fn = accounting_calloc;
+  hooks.realloc_fn = accounting_realloc;
+  hooks.free_fn = accounting_free;
+  hooks.user = &accounting_base;
+  atomic_store(&accounting, 1);
+  return 0;
+}
+
+allocator_stage allocator_set_stage(allocator_stage stage)
+{
+  allocator_stage ret = local_stage;
+  if ((unsigned) stage < ALLOCATOR_STAGE_COUNT)
+    local_stage = stage;
+  return ret;
+}
+
+int allocator_get_stats(allocator_stage stage, allocator_stats *out_stats)
+{
+  if ((unsigned) stage > ALLOCATOR_STAGE_COUNT || out_stats == NULL || !atomic_load(&accounting))
+    return -1;
+
+  out_stats->live_bytes = atomic_load(&stats[stage].live_bytes);
+  out_stats->peak_bytes = atomic_load(&stats[stage].peak_bytes);
+  out_stats->allocation_count = atomic_load(&stats[stage].allocation_count);
+  out_stats->free_count = atomic_load(&stats[stage].free_count);
+  return 0;
+}
+
+void allocator_reset_peaks(void)
+{
+  for (int i = 0; i <= ALLOCATOR_STAGE_COUNT; ++i)
+    atomic_store(&stats[i].peak_bytes, atomic_load(&stats[i].live_bytes));
+}
+
+void *allocator_malloc(size_t size)
+{
+  mark_hooks_used();
+  return hooks.malloc_fn(size, hooks.user);
+}
+
+void *allocator_calloc(size_t count, size_t size)
+{
+  mark_hooks_used();
+  return hooks.calloc_fn(count, size, hooks.user);
+}
+
+void *allocator_realloc(void *ptr, size_t size)
+{
+  mark_hooks_used();
+  return hooks.realloc_fn(ptr, size, hooks.user);
+}
+
+void allocator_free(void *ptr)
+{
+  hooks.free_fn(ptr, hooks.user);
+}
+
+char *allocator_strdup(const char *string)
+{
+  size_t size = strlen(string) + 1;
+  char *ret = (char*) allocator_malloc(size);
+  if (ret != NULL)
+    memcpy(ret, string, size);
+  return ret;
+}
@@ -0,0 +1,74 @@
+#ifndef ALLOCATOR_H_
+#define ALLOCATOR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// every heap allocation of the library goes through these hooks, mxml's included. the default is the c library.
+
+typedef struct
+{
+  void *(*malloc_fn)(size_t size, void *user);
+  void *(*calloc_fn)(size_t count, size_t size, void *user);
+  void *(*realloc_fn)(void *ptr, size_t size, void *user);
+  void (*free_fn)(void *ptr, void *user);
+  void *user;
+} allocator_hooks;
+
+// what an allocation was made for, taken from the allocating thread's current stage.
+typedef enum
+{
+  ALLOCATOR_STAGE_OTHER,    // anything not covered below, e.g. objects created by the caller.
+  ALLOCATOR_STAGE_INDEX,    // the song index of set_music_roots and the .1 cache's bookkeeping.
+  ALLOCATOR_STAGE_MANIFEST, // opening an ifs: the manifest, its kbinxml decode and the mxml tree.
+  ALLOCATOR_STAGE_CHART,    // .1 files and charts read into memory.
+  ALLOCATOR_STAGE_SCAN,     // counting notes: chart streams and batch scratch.
+  ALLOCATOR_STAGE_COUNT
+} allocator_stage;
+
+typedef struct
+{
+  uint64_t live_bytes;
+  uint64_t peak_bytes;
+  uint64_t allocation_count;
+  uint64_t free_count;
+} allocator_stats;
+
+// installs hooks, NULL goes back to the c library. every callback must be set.
+// the hooks are fixed by the library's first allocation, from then on this returns -1. call it at startup, before
+// using the rest of the library on any thread.
+int allocator_set_hooks(const allocator_hooks *hooks);
+
+// installs the accounting allocator on top of hooks (NULL for the c library) and resets its stats.
+// same rules as allocator_set_hooks, allocator_set_hooks turns it off again while nothing has been allocated.
+int allocator_set_accounting(const allocator_hooks *hooks);
+
+// sets the calling thread's stage and returns the previous one, to be put back when the stage is done.
+// the library sets its own stages internally, callers may wrap their own calls too.
+allocator_stage allocator_set_stage(allocator_stage stage);
+
+// live, peak and count stats of the accounting allocator, ALLOCATOR_STAGE_COUNT gives the totals.
+// a block stays accounted to the stage it was allocated in wherever it's freed. returns -1 if accounting is off.
+int allocator_get_stats(allocator_stage stage, allocator_stats *out_stats);
+// starts measuring new peaks from the current live bytes.
+void allocator_reset_peaks(void);
+
+// the library's own allocation functions, routed through the installed hooks.
+// buffers the library hands back to the caller (e.g. load_iidx_1) must be released with allocator_free. this changed
+// from earlier versions, where they were released with free(). with the default hooks they are still plain malloc
+// blocks and free() keeps working, with custom hooks or accounting only allocator_free does.
+void *allocator_malloc(size_t size);
+void *allocator_calloc(size_t count, size_t size);
+void *allocator_realloc(void *ptr, size_t size);
+void allocator_free(void *ptr);
+char *allocator_strdup(const char *string);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ALLOCATOR_H_
@@ -5,21 +5,46 @@
 extern "C" {
 #endif
 
+#include <assert.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifndef BINARY_STREAM_ASSERT
   #define BINARY_STREAM_ASSERT(x) assert(x)
 #endif
 
+// the stream objects' allocator, define both before including the definitions to use your own.
+#ifndef BINARY_STREAM_MALLOC
+  #define BINARY_STREAM_MALLOC(size) malloc(size)
+  #define BINARY_STREAM_FREE(ptr) free(ptr)
+#endif
+
+// detect the host byte order at compile time. windows only runs on little endian hosts.
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  #define BINARY_STREAM_HOST_BIG_ENDIAN 1
+#else
+  #define BINARY_STREAM_HOST_BIG_ENDIAN 0
+#endif
+
 typedef struct binary_stream_s binary_stream;
 
+// prefixed to avoid clashing with the LITTLE_ENDIAN/BIG_ENDIAN macros from <endian.h>.
 typedef enum
 {
-  LITTLE_ENDIAN,
-  BIG_ENDIAN
+  BS_LITTLE_ENDIAN,
+  BS_BIG_ENDIAN
 } endianness;
 
+struct binary_stream_s
+{
+  uint8_t *data;
+  uint32_t size;
+
+  uint32_t offset;
+  endianness endian;
+};
+
 // create/destroy functions.
 binary_stream *bs_open(void *data, uint32_t size);
 binary_stream *bs_duplicate(binary_stream *bs);
@@ -35,7 +60,7 @@ void bs_set_offset(binary_stream *bs, uint32_t offset);
 void bs_set_endianness(binary_stream *bs, endianness endian);
 void bs_add_offset(binary_stream *bs, uint32_t offset);
 
-// read from the stream.
+// read from the stream using the stream's endianness (checked on every call).
 uint8_t bs_peek_u8(binary_stream *bs);
 uint8_t bs_read_u8(binary_stream *bs);
 uint16_t bs_read_u16(binary_stream *bs);
@@ -48,45 +73,111 @@ uint32_t bs_read_bytes(binary_stream *bs, void *out, uint32_t size); // returns
 // alignment.
 void bs_realign32(binary_stream *bs);
 
-inline uint16_t byte_swap16(uint16_t bytes)
+static inline uint16_t byte_swap16(uint16_t bytes)
 {
+#if defined(_MSC_VER)
   return _byteswap_ushort(bytes);
+#elif defined(__GNUC__) || defined(__clang__)
+  return __builtin_bswap16(bytes);
+#else
+  return (uint16_t) ((bytes >> 8) | (bytes << 8));
+#endif
 }
 
-inline uint32_t byte_swap32(uint32_t bytes)
+static inline uint32_t byte_swap32(uint32_t bytes)
 {
+#if defined(_MSC_VER)
   return _byteswap_ulong(bytes);
+#elif defined(__GNUC__) || defined(__clang__)
+  return __builtin_bswap32(bytes);
+#else
+  return ((bytes >> 24) & 0x000000ff) | ((bytes >> 8) & 0x0000ff00) |
+         ((bytes << 8) & 0x00ff0000) | ((bytes << 24) & 0xff000000);
+#endif
 }
 
-inline uint64_t byte_swap64(uint64_t bytes)
+static inline uint64_t byte_swap64(uint64_t bytes)
 {
+#if defined(_MSC_VER)
   return _byteswap_uint64(bytes);
+#elif defined(__GNUC__) || defined(__clang__)
+  return __builtin_bswap64(bytes);
+#else
+  return ((uint64_t) byte_swap32((uint32_t) bytes) << 32) | byte_swap32((uint32_t) (bytes >> 32));
+#endif
 }
 
-#ifdef BINARY_STREAM_DEFINITIONS
+static inline uint32_t bs_min_u32(uint32_t a, uint32_t b)
+{
+  return a < b ? a : b;
+}
 
-#include <assert.h>
-#include <string.h>
+// fixed endianness readers, picked at compile time by the caller so there is no per-read branch.
+// memcpy keeps unaligned reads well defined and compiles down to a single load.
+#define BINARY_STREAM_FIXED_READER(bits, suffix, swap) \
+  static inline uint##bits##_t bs_read_u##bits##_##suffix(binary_stream *bs) \
+  { \
+    BINARY_STREAM_ASSERT(bs); \
+    BINARY_STREAM_ASSERT(bs->offset + (bits / 8) <= bs->size); \
+    uint##bits##_t ret; \
+    memcpy(&ret, bs->data + bs->offset, sizeof(ret)); \
+    bs->offset += bits / 8; \
+    return swap ? byte_swap##bits(ret) : ret; \
+  }
 
-struct binary_stream_s
+BINARY_STREAM_FIXED_READER(16, le, BINARY_STREAM_HOST_BIG_ENDIAN)
+BINARY_STREAM_FIXED_READER(32, le, BINARY_STREAM_HOST_BIG_ENDIAN)
+BINARY_STREAM_FIXED_READER(64, le, BINARY_STREAM_HOST_BIG_ENDIAN)
+BINARY_STREAM_FIXED_READER(16, be, !BINARY_STREAM_HOST_BIG_ENDIAN)
+BINARY_STREAM_FIXED_READER(32, be, !BINARY_STREAM_HOST_BIG_ENDIAN)
+BINARY_STREAM_FIXED_READER(64, be, !BINARY_STREAM_HOST_BIG_ENDIAN)
+
+#undef BINARY_STREAM_FIXED_READER
+
+static inline float bs_read_f32_le(binary_stream *bs)
 {
-  uint8_t *data;
-  uint32_t size;
+  uint32_t val = bs_read_u32_le(bs);
+  float ret;
+  memcpy(&ret, &val, sizeof(ret));
+  return ret;
+}
 
-  uint32_t offset;
-  endianness endian;
-};
+static inline double bs_read_f64_le(binary_stream *bs)
+{
+  uint64_t val = bs_read_u64_le(bs);
+  double ret;
+  memcpy(&ret, &val, sizeof(ret));
+  return ret;
+}
+
+static inline float bs_read_f32_be(binary_stream *bs)
+{
+  uint32_t val = bs_read_u32_be(bs);
+  float ret;
+  memcpy(&ret, &val, sizeof(ret));
+  return ret;
+}
+
+static inline double bs_read_f64_be(binary_stream *bs)
+{
+  uint64_t val = bs_read_u64_be(bs);
+  double ret;
+  memcpy(&ret, &val, sizeof(ret));
+  return ret;
+}
+
+#ifdef BINARY_STREAM_DEFINITIONS
 
 binary_stream *bs_open(void *data, uint32_t size)
 {
   BINARY_STREAM_ASSERT(data != NULL && size > 0);
   
-  binary_stream *ret = (binary_stream*) malloc(sizeof(binary_stream));
+  binary_stream *ret = (binary_stream*) BINARY_STREAM_MALLOC(sizeof(binary_stream));
   BINARY_STREAM_ASSERT(ret);
   ret->data = (uint8_t*) data;
   ret->size = size;
   ret->offset = 0;
-  ret->endian = LITTLE_ENDIAN;
+  ret->endian = BS_LITTLE_ENDIAN;
 
   return ret;
 }
@@ -95,7 +186,7 @@ binary_stream *bs_duplicate(binary_stream *bs)
 {
   BINARY_STREAM_ASSERT(bs);
   
-  binary_stream *ret = (binary_stream*) malloc(sizeof(binary_stream));
+  binary_stream *ret = (binary_stream*) BINARY_STREAM_MALLOC(sizeof(binary_stream));
   ret->data = bs->data;
   ret->size = bs->size;
   ret->offset = bs->offset;
@@ -107,7 +198,7 @@ binary_stream *bs_duplicate(binary_stream *bs)
 void bs_close(binary_stream *bs)
 {
   BINARY_STREAM_ASSERT(bs);
-  free(bs);
+  BINARY_STREAM_FREE(bs);
 }
 
 uint32_t bs_get_offset(const binary_stream *bs)
@@ -131,7 +222,7 @@ int bs_at_end(const binary_stream *bs)
 void bs_set_offset(binary_stream *bs, uint32_t offset)
 {
   BINARY_STREAM_ASSERT(bs);
-  bs->offset = min(offset, bs->size);
+  bs->offset = bs_min_u32(offset, bs->size);
 }
 
 void bs_set_endianness(binary_stream *bs, endianness endian)
@@ -143,7 +234,7 @@ void bs_set_endianness(binary_stream *bs, endianness endian)
 void bs_add_offset(binary_stream *bs, uint32_t offset)
 {
   BINARY_STREAM_ASSERT(bs);
-  bs->offset = min(bs->offset + offset, bs->size);
+  bs->offset = bs_min_u32(bs->offset + offset, bs->size);
 }
 
 uint8_t bs_peek_u8(binary_stream *bs)
@@ -167,43 +258,31 @@ uint8_t bs_read_u8(binary_stream *bs)
 uint16_t bs_read_u16(binary_stream *bs)
 {
   BINARY_STREAM_ASSERT(bs);
-  BINARY_STREAM_ASSERT(bs->offset + 2 <= bs->size);
-
-  uint16_t ret = *(uint16_t*) (bs->data + bs->offset);
-  bs->offset += 2;
-  return bs->endian == BIG_ENDIAN ? byte_swap16(ret) : ret;
+  return bs->endian == BS_BIG_ENDIAN ? bs_read_u16_be(bs) : bs_read_u16_le(bs);
 }
 
 uint32_t bs_read_u32(binary_stream *bs)
 {
   BINARY_STREAM_ASSERT(bs);
-  BINARY_STREAM_ASSERT(bs->offset + 4 <= bs->size);
-
-  uint32_t ret = *(uint32_t*) (bs->data + bs->offset);
-  bs->offset += 4;
-  return bs->endian == BIG_ENDIAN ? byte_swap32(ret) : ret;
+  return bs->endian == BS_BIG_ENDIAN ? bs_read_u32_be(bs) : bs_read_u32_le(bs);
 }
 
 uint64_t bs_read_u64(binary_stream *bs)
 {
   BINARY_STREAM_ASSERT(bs);
-  BINARY_STREAM_ASSERT(bs->offset + 8 <= bs->size);
-
-  uint64_t ret = *(uint64_t*) (bs->data + bs->offset);
-  bs->offset += 8;
-  return bs->endian == BIG_ENDIAN ? byte_swap64(ret) : ret;
+  return bs->endian == BS_BIG_ENDIAN ? bs_read_u64_be(bs) : bs_read_u64_le(bs);
 }
 
 float bs_read_f32(binary_stream *bs)
 {
-  uint32_t val = bs_read_u32(bs);
-  return *(float*) &val;
+  BINARY_STREAM_ASSERT(bs);
+  return bs->endian == BS_BIG_ENDIAN ? bs_read_f32_be(bs) : bs_read_f32_le(bs);
 }
 
 double bs_read_f64(binary_stream *bs)
 {
-  uint64_t val = bs_read_u64(bs);
-  return *(double*) &val;
+  BINARY_STREAM_ASSERT(bs);
+  return bs->endian == BS_BIG_ENDIAN ? bs_read_f64_be(bs) : bs_read_f64_le(bs);
 }
 
 uint32_t bs_read_bytes(binary_stream *bs, void *out, uint32_t size)
@@ -211,7 +290,7 @@ uint32_t bs_read_bytes(binary_stream *bs, void *out, uint32_t size)
   BINARY_STREAM_ASSERT(bs);
   BINARY_STREAM_ASSERT(out && size > 0);
 
-  size = min(size, bs->size - bs->offset);
+  size = bs_min_u32(size, bs->size - bs->offset);
   memcpy(out, bs->data + bs->offset, size);
   bs->offset += size;
 
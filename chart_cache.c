@@ -0,0 +1,245 @@
+#include "chart_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+
+// xxh64 primes.
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+// grow the table once it's more than 3/4 full.
+#define MAX_LOAD_NUMERATOR 3
+#define MAX_LOAD_DENOMINATOR 4
+
+typedef struct
+{
+  uint64_t hash;
+  uint32_t length;
+  int note_count;
+  uint32_t references; // charts resolved to this entry.
+  int used;
+} chart_cache_entry;
+
+struct chart_cache_s
+{
+  chart_cache_entry *entries;
+  uint32_t capacity; // always a power of 2.
+  uint32_t count;
+};
+
+static uint64_t rotl64(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t read64(const uint8_t *p)
+{
+  uint64_t ret;
+  memcpy(&ret, p, sizeof(ret));
+  return ret;
+}
+
+static uint32_t read32(const uint8_t *p)
+{
+  uint32_t ret;
+  memcpy(&ret, p, sizeof(ret));
+  return ret;
+}
+
+static uint64_t hash_round(uint64_t acc, uint64_t input)
+{
+  acc += input * PRIME64_2;
+  acc = rotl64(acc, 31);
+  return acc * PRIME64_1;
+}
+
+static uint64_t hash_merge(uint64_t acc, uint64_t val)
+{
+  acc ^= hash_round(0, val);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t chart_cache_hash(const uint8_t *data, uint32_t length)
+{
+  const uint8_t *p = data;
+  const uint8_t *end = data + length;
+  uint64_t h;
+
+  if (length >= 32)
+  {
+    // hash 32 byte stripes across 4 independent lanes.
+    uint64_t v1 = PRIME64_1 + PRIME64_2;
+    uint64_t v2 = PRIME64_2;
+    uint64_t v3 = 0;
+    uint64_t v4 = 0 - PRIME64_1;
+    const uint8_t *limit = end - 32;
+    do
+    {
+      v1 = hash_round(v1, read64(p));
+      v2 = hash_round(v2, read64(p + 8));
+      v3 = hash_round(v3, read64(p + 16));
+      v4 = hash_round(v4, read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = hash_merge(h, v1);
+    h = hash_merge(h, v2);
+    h = hash_merge(h, v3);
+    h = hash_merge(h, v4);
+  }
+  else
+  {
+    h = PRIME64_5;
+  }
+
+  h += length;
+
+  // consume the tail.
+  while (p + 8 <= end)
+  {
+    h ^= hash_round(0, read64(p));
+    h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    p += 8;
+  }
+  if (p + 4 <= end)
+  {
+    h ^= (uint64_t) read32(p) * PRIME64_1;
+    h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+  while (p < end)
+  {
+    h ^= (*p) * PRIME64_5;
+    h = rotl64(h, 11) * PRIME64_1;
+    ++p;
+  }
+
+  // final avalanche.
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+static chart_cache_entry *find_slot(chart_cache_entry *entries, uint32_t capacity, uint64_t hash, uint32_t length)
+{
+  // linear probe until we find the key or an empty slot.
+  uint32_t mask = capacity - 1;
+  uint32_t i = (uint32_t) hash & mask;
+  while (entries[i].used && (entries[i].hash != hash || entries[i].length != length))
+    i = (i + 1) & mask;
+
+  return &entries[i];
+}
+
+static int grow(chart_cache *cache)
+{
+  uint32_t new_capacity = cache->capacity * 2;
+  chart_cache_entry *new_entries = (chart_cache_entry*) allocator_calloc(new_capacity, sizeof(chart_cache_entry));
+  if (new_entries == NULL)
+    return -1;
+
+  // rehash every used entry into the new table.
+  for (uint32_t i = 0; i < cache->capacity; ++i)
+  {
+    if (cache->entries[i].used)
+      *find_slot(new_entries, new_capacity, cache->entries[i].hash, cache->entries[i].length) = cache->entries[i];
+  }
+
+  allocator_free(cache->entries);
+  cache->entries = new_entries;
+  cache->capacity = new_capacity;
+  return 0;
+}
+
+chart_cache *chart_cache_create(uint32_t initial_capacity)
+{
+  // round capacity up to a power of 2.
+  uint32_t capacity = 16;
+  while (capacity < initial_capacity && capacity < 0x80000000)
+    capacity <<= 1;
+
+  chart_cache *ret = (chart_cache*) allocator_malloc(sizeof(chart_cache));
+  if (ret == NULL)
+    return NULL;
+
+  ret->entries = (chart_cache_entry*) allocator_calloc(capacity, sizeof(chart_cache_entry));
+  if (ret->entries == NULL)
+  {
+    allocator_free(ret);
+    return NULL;
+  }
+  ret->capacity = capacity;
+  ret->count = 0;
+
+  return ret;
+}
+
+void chart_cache_destroy(chart_cache *cache)
+{
+  if (cache == NULL)
+    return;
+
+  allocator_free(cache->entries);
+  allocator_free(cache);
+}
+
+int chart_cache_find(chart_cache *cache, uint64_t hash, uint32_t length, int *out_note_count)
+{
+  if (cache == NULL || out_note_count == NULL)
+    return 0;
+
+  chart_cache_entry *entry = find_slot(cache->entries, cache->capacity, hash, length);
+  if (!entry->used)
+    return 0;
+
+  ++entry->references;
+  *out_note_count = entry->note_count;
+  return 1;
+}
+
+int chart_cache_insert(chart_cache *cache, uint64_t hash, uint32_t length, int note_count)
+{
+  if (cache == NULL)
+    return -1;
+
+  // make room before inserting so the probe never runs out of empty slots.
+  if ((cache->count + 1) * MAX_LOAD_DENOMINATOR > cache->capacity * MAX_LOAD_NUMERATOR && grow(cache))
+    return -1;
+
+  chart_cache_entry *entry = find_slot(cache->entries, cache->capacity, hash, length);
+  if (!entry->used)
+  {
+    entry->used = 1;
+    entry->hash = hash;
+    entry->length = length;
+    entry->references = 0;
+    ++cache->count;
+  }
+  ++entry->references;
+  entry->note_count = note_count;
+
+  return 0;
+}
+
+uint32_t chart_cache_get_count(const chart_cache *cache)
+{
+  return cache == NULL ? 0 : cache->count;
+}
+
+uint32_t chart_cache_get_references(const chart_cache *cache, uint64_t hash, uint32_t length)
+{
+  if (cache == NULL)
+    return 0;
+
+  chart_cache_entry *entry = find_slot(cache->entries, cache->capacity, hash, length);
+  return entry->used ? entry->references : 0;
+}
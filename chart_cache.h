@@ -0,0 +1,38 @@
+#ifndef CHART_CACHE_H_
+#define CHART_CACHE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// content-addressed cache of per-chart statistics, keyed by a hash of the chart's bytes.
+// charts that are byte-identical (e.g. reused between game versions) are only scanned once.
+// the cache doesn't keep the bytes, two charts with the same 64 bit hash and length are taken to be the same chart.
+// with a few million charts the odds of any xxh64 collision stay below 1 in 10^6, a wrong count is accepted at that rate.
+// not thread-safe, a cache must only be used by one thread at a time.
+typedef struct chart_cache_s chart_cache;
+
+// create/destroy functions.
+chart_cache *chart_cache_create(uint32_t initial_capacity);
+void chart_cache_destroy(chart_cache *cache);
+
+// fast non-cryptographic 64 bit hash of a chart's bytes.
+uint64_t chart_cache_hash(const uint8_t *data, uint32_t length);
+
+// lookup/insert by content key. find returns 1 on a hit, 0 on a miss.
+// every hit and insert counts as one more chart sharing the entry.
+int chart_cache_find(chart_cache *cache, uint64_t hash, uint32_t length, int *out_note_count);
+int chart_cache_insert(chart_cache *cache, uint64_t hash, uint32_t length, int note_count);
+
+// getters.
+uint32_t chart_cache_get_count(const chart_cache *cache);
+// how many charts resolved to the entry for a key, 0 if it isn't cached.
+uint32_t chart_cache_get_references(const chart_cache *cache, uint64_t hash, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CHART_CACHE_H_
@@ -0,0 +1,75 @@
+#include "disk_order.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+  #include <sys/stat.h>
+#else
+  #include <fcntl.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#ifdef __linux__
+  #include <linux/fiemap.h>
+  #include <linux/fs.h>
+  #include <sys/ioctl.h>
+#endif
+
+#ifdef __linux__
+static int get_physical_offset(int fd, uint64_t *out_offset)
+{
+  // only the first extent is needed, that's where reading starts.
+  uint64_t buffer[(sizeof(struct fiemap) + sizeof(struct fiemap_extent)) / sizeof(uint64_t)];
+  memset(buffer, 0, sizeof(buffer));
+  struct fiemap *map = (struct fiemap*) buffer;
+  map->fm_start = 0;
+  map->fm_length = ~0ULL;
+  map->fm_extent_count = 1;
+
+  if (ioctl(fd, FS_IOC_FIEMAP, map) < 0 || map->fm_mapped_extents == 0 ||
+      (map->fm_extents[0].fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC)))
+    return -1;
+
+  *out_offset = map->fm_extents[0].fe_physical;
+  return 0;
+}
+#endif
+
+int disk_order_get_position(const char *path, disk_position *out_position)
+{
+  if (path == NULL || out_position == NULL)
+    return -1;
+
+#ifdef _WIN32
+  struct _stat64 st;
+  if (_stat64(path, &st))
+    return -1;
+  out_position->device = (uint64_t) st.st_dev;
+  out_position->position = 0;
+  return 0;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  struct stat st;
+  if (fstat(fd, &st))
+  {
+    close(fd);
+    return -1;
+  }
+  out_position->device = (uint64_t) st.st_dev;
+  out_position->position = (uint64_t) st.st_ino;
+
+#ifdef __linux__
+  // filesystems without FIEMAP (tmpfs, network mounts) fall back to the inode.
+  uint64_t physical_offset;
+  if (get_physical_offset(fd, &physical_offset) == 0)
+    out_position->position = physical_offset;
+#endif
+
+  close(fd);
+  return 0;
+#endif
+}
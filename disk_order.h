@@ -0,0 +1,27 @@
+#ifndef DISK_ORDER_H_
+#define DISK_ORDER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// helpers for reading many files in the order they sit on disk, which saves most of the seeking on rotational storage.
+
+// where a file's data starts on disk. sorting by (device, position) gives the physical read order.
+typedef struct
+{
+  uint64_t device;
+  uint64_t position;
+} disk_position;
+
+// the first extent's physical offset where FIEMAP is supported (linux), otherwise the inode number as an
+// approximation. on windows every file gets position 0, so the caller's order is kept.
+int disk_order_get_position(const char *path, disk_position *out_position);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DISK_ORDER_H_
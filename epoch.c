@@ -0,0 +1,157 @@
+#include "epoch.h"
+
+#include <stdatomic.h>
+
+#include "allocator.h"
+#include "thread.h"
+
+// one per reading thread, shared by every user. epoch is 0 while the thread isn't reading.
+struct epoch_record_s
+{
+  struct epoch_record_s *next;
+  atomic_uint_fast64_t epoch;
+  atomic_int in_use; // 0 once the owning thread exited, the next new reader takes it over.
+};
+
+static atomic_uint_fast64_t global_epoch = 1;
+static _Atomic(epoch_record*) records;
+
+static THREAD_LOCAL epoch_record *local_record;
+
+// hands a thread's record back when it exits, created with the first record.
+static mutex record_key_mutex = MUTEX_INITIALIZER;
+static atomic_int record_key_created;
+static thread_key record_key;
+
+static void THREAD_KEY_CALL release_record(void *data)
+{
+  // records stay in the list so readers of it never see one freed, they're only marked for reuse.
+  epoch_record *record = (epoch_record*) data;
+  atomic_store(&record->epoch, 0);
+  atomic_store_explicit(&record->in_use, 0, memory_order_release);
+}
+
+static int create_record_key(void)
+{
+  if (atomic_load(&record_key_created))
+    return 0;
+
+  mutex_lock(&record_key_mutex);
+  if (!atomic_load(&record_key_created) && thread_key_create(&record_key, release_record) == 0)
+    atomic_store(&record_key_created, 1);
+  mutex_unlock(&record_key_mutex);
+  return atomic_load(&record_key_created) ? 0 : -1;
+}
+
+static epoch_record *claim_record(void)
+{
+  // take over the record of a thread that exited before growing the list.
+  for (epoch_record *record = atomic_load(&records); record != NULL; record = record->next)
+  {
+    int expected = 0;
+    if (atomic_load_explicit(&record->in_use, memory_order_relaxed) == 0 &&
+        atomic_compare_exchange_strong(&record->in_use, &expected, 1))
+      return record;
+  }
+
+  epoch_record *record = (epoch_record*) allocator_malloc(sizeof(epoch_record));
+  if (record == NULL)
+    return NULL;
+  atomic_init(&record->epoch, 0);
+  atomic_init(&record->in_use, 1);
+
+  // lock-free push onto the list of records.
+  record->next = atomic_load_explicit(&records, memory_order_relaxed);
+  while (!atomic_compare_exchange_weak_explicit(&records, &record->next, record, memory_order_release, memory_order_relaxed))
+    ;
+  return record;
+}
+
+static epoch_record *get_record(void)
+{
+  if (local_record != NULL)
+    return local_record;
+
+  if (create_record_key())
+    return NULL;
+  epoch_record *record = claim_record();
+  if (record == NULL)
+    return NULL;
+  if (thread_key_set(record_key, record))
+  {
+    release_record(record);
+    return NULL;
+  }
+
+  local_record = record;
+  return record;
+}
+
+epoch_record *epoch_enter(void)
+{
+  // announce the epoch before the caller loads anything, writers won't free what this reader can still reach.
+  epoch_record *record = get_record();
+  if (record != NULL)
+    atomic_store(&record->epoch, atomic_load(&global_epoch));
+  return record;
+}
+
+void epoch_exit(epoch_record *record)
+{
+  atomic_store_explicit(&record->epoch, 0, memory_order_release);
+}
+
+void epoch_retire(epoch_retired **list, epoch_retired *retired, void *data, void (*destroy)(void *data))
+{
+  // readers that announce a later epoch can only load the new pointer.
+  retired->data = data;
+  retired->destroy = destroy;
+  retired->epoch = atomic_fetch_add(&global_epoch, 1);
+  retired->next = *list;
+  *list = retired;
+}
+
+void epoch_reclaim(epoch_retired **list)
+{
+  // the oldest epoch any reader is still in.
+  uint64_t oldest_epoch = UINT64_MAX;
+  for (epoch_record *record = atomic_load(&records); record != NULL; record = record->next)
+  {
+    uint64_t epoch = atomic_load(&record->epoch);
+    if (epoch != 0 && epoch < oldest_epoch)
+      oldest_epoch = epoch;
+  }
+
+  epoch_retired **link = list;
+  while (*link != NULL)
+  {
+    epoch_retired *retired = *link;
+    if (retired->epoch < oldest_epoch)
+    {
+      *link = retired->next;
+      retired->destroy(retired->data);
+      allocator_free(retired);
+    }
+    else
+      link = &retired->next;
+  }
+}
+
+void epoch_reclaim_all(epoch_retired **list)
+{
+  while (*list != NULL)
+  {
+    epoch_retired *retired = *list;
+    *list = retired->next;
+    retired->destroy(retired->data);
+    allocator_free(retired);
+  }
+}
+
+uint32_t epoch_get_record_count(void)
+{
+  uint32_t count = 0;
+  for (epoch_record *record = atomic_load(&records); record != NULL; record = record->next)
+    ++count;
+  return count;
+}
@@ -0,0 +1,46 @@
+#ifndef EPOCH_H_
+#define EPOCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// epoch based reclamation for data that is read without locks and replaced by swapping a pointer (note_table's
+// snapshots, the song index of set_music_roots). readers announce the current epoch before loading the pointer and
+// clear it when done, writers tag what they replaced with the epoch it was retired in and only free it once no reader
+// is still in that epoch or an earlier one.
+
+typedef struct epoch_record_s epoch_record;
+
+// a replaced object waiting to be freed, allocated by the writer before swapping so retiring can't fail.
+typedef struct epoch_retired_s
+{
+  struct epoch_retired_s *next;
+  void *data;
+  void (*destroy)(void *data);
+  uint64_t epoch;
+} epoch_retired;
+
+// starts a read section on the calling thread, the shared pointer must be loaded after this. sections don't nest.
+// returns NULL if the thread's record can't be allocated.
+epoch_record *epoch_enter(void);
+void epoch_exit(epoch_record *record);
+
+// the list functions don't lock, callers serialise them (e.g. with the writers' mutex).
+// adds data to list after its pointer was swapped out, retired is freed with allocator_free once data is destroyed.
+void epoch_retire(epoch_retired **list, epoch_retired *retired, void *data, void (*destroy)(void *data));
+// destroys everything in list no reader can reach anymore.
+void epoch_reclaim(epoch_retired **list);
+// destroys everything in list, nothing may be reading.
+void epoch_reclaim_all(epoch_retired **list);
+
+// getters. every thread that ever read holds a record, a thread's record is reused by later threads once it exits.
+uint32_t epoch_get_record_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EPOCH_H_
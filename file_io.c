@@ -0,0 +1,33 @@
+#include "file_io.h"
+
+#ifdef _WIN32
+  #include <io.h>
+  #include <windows.h>
+#else
+  #include <unistd.h>
+#endif
+
+int file_read_at(int fd, uint64_t position, void *out, uint32_t size)
+{
+  uint8_t *cur = (uint8_t*) out;
+  while (size > 0)
+  {
+#ifdef _WIN32
+    OVERLAPPED overlapped = {0};
+    overlapped.Offset = (DWORD) position;
+    overlapped.OffsetHigh = (DWORD) (position >> 32);
+    DWORD bytes_read = 0;
+    if (!ReadFile((HANDLE) _get_osfhandle(fd), cur, size, &bytes_read, &overlapped) || bytes_read == 0)
+      return -1;
+#else
+    ssize_t bytes_read = pread(fd, cur, size, (off_t) position);
+    if (bytes_read <= 0)
+      return -1;
+#endif
+    cur += bytes_read;
+    position += (uint64_t) bytes_read;
+    size -= (uint32_t) bytes_read;
+  }
+
+  return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef FILE_IO_H_
+#define FILE_IO_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// reads exactly size bytes at position, retrying short reads. positional reads leave the file position alone, so
+// concurrent readers of one descriptor don't interfere and a caller's descriptor isn't disturbed.
+// returns -1 on errors and on reaching the end of the file early.
+int file_read_at(int fd, uint64_t position, void *out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FILE_IO_H_
@@ -1,9 +1,37 @@
+// copy_file_range is a gnu extension.
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+  #define _GNU_SOURCE
+#endif
+
 #include "ifs.h"
 
+#include <errno.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <io.h>
+  #include <sys/stat.h>
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#ifdef __linux__
+  #include <sys/sendfile.h>
+#endif
 
+#include "allocator.h"
 #include "binary_stream.h"
+#include "file_io.h"
+#include "ifs_internal.h"
 #include "kbinxml.h"
+#include "trace.h"
 
 #define SIGNATURE 0x6CAD8F89
 
@@ -17,19 +45,37 @@ typedef struct
   uint32_t manifest_end;
 } ifs_header;
 
-ifs_error ifs_extract_manifest(const char *path, mxml_node_t **out_manifest, uint32_t *out_manifest_end)
+#define MAX_MANIFEST_DEPTH 32
+#define EXTRACT_CHUNK_SIZE 0x10000
+
+static atomic_uint copy_methods = IFS_COPY_ALL;
+
+struct ifs_archive_s
 {
-  if (path == NULL || out_manifest == NULL || out_manifest_end == NULL)
-    return IFS_INVALID_PARAM;
+  FILE *file;
+  uint64_t file_size;
+  int64_t file_mtime;
+  uint32_t manifest_end;
 
-  // Read the entire file into a buffer.
-  FILE *file = fopen(path, "rb");
-  if (file == NULL)
-    return IFS_FILE_FAILED;
+  // file entries sorted by path, paths are stored in a single block.
+  ifs_entry *entries;
+  uint32_t entry_count;
+  char *paths;
 
+  // whole-archive mapping for zero-copy views, NULL if mapping isn't available.
+  const uint8_t *mapping;
+#ifdef _WIN32
+  HANDLE mapping_handle;
+#endif
+};
+
+static ifs_error load_manifest(FILE *file, mxml_node_t **out_manifest, uint32_t *out_manifest_end)
+{
   // read in the header.
+  TRACE_BEGIN("read_header");
   ifs_header header;
   size_t elements_read = fread(&header, sizeof(header), 1, file);
+  TRACE_END("read_header");
 
   // swap endianness as the header is stored in big endian.
   header.signature = byte_swap32(header.signature);
@@ -43,40 +89,37 @@ ifs_error ifs_extract_manifest(const char *path, mxml_node_t **out_manifest, uin
   if (elements_read < 1 ||
       header.signature != SIGNATURE ||
       (header.version ^ header.not_version) != 0xffff)
-  {
-    fclose(file);
     return IFS_INVALID_FILE;
-  }
 
   // skip manifest md5.
   char md5[16];
-  if (header.version > 1)
-    fread(md5, sizeof(char), sizeof(md5), file);
-  
+  if (header.version > 1 && fread(md5, sizeof(char), sizeof(md5), file) < sizeof(md5))
+    return IFS_INVALID_FILE;
+
   // allocate a buffer for the manifest.
-  uint32_t manifest_size = header.manifest_end - ftell(file);
-  uint8_t *manifest_buffer = (uint8_t*) malloc(manifest_size);
+  long manifest_start = ftell(file);
+  if (manifest_start < 0 || header.manifest_end <= (uint32_t) manifest_start)
+    return IFS_INVALID_FILE;
+  uint32_t manifest_size = header.manifest_end - (uint32_t) manifest_start;
+  uint8_t *manifest_buffer = (uint8_t*) allocator_malloc(manifest_size);
   if (manifest_buffer == NULL)
-  {
-    fclose(file);
     return IFS_MEM_FAILED;
-  }
 
   // read in the manifest.
+  TRACE_BEGIN_VALUE("read_manifest", manifest_size);
   elements_read = fread(manifest_buffer, sizeof(uint8_t), manifest_size, file);
+  TRACE_END("read_manifest");
   if (elements_read < manifest_size)
   {
-    free(manifest_buffer);
-    fclose(file);
+    allocator_free(manifest_buffer);
     return IFS_INVALID_FILE;
   }
 
   // convert from binary to xml.
+  TRACE_BEGIN("kbinxml_from_binary");
   mxml_node_t *manifest = kbinxml_from_binary(manifest_buffer, manifest_size);
-
-  // cleanup, check for manifest parse error.
-  free(manifest_buffer);
-  fclose(file);
+  TRACE_END("kbinxml_from_binary");
+  allocator_free(manifest_buffer);
   if (manifest == NULL)
     return IFS_MANIFEST_PARSE_ERROR;
 
@@ -86,3 +129,469 @@ ifs_error ifs_extract_manifest(const char *path, mxml_node_t **out_manifest, uin
 
   return IFS_NO_ERROR;
 }
+
+ifs_error ifs_extract_manifest(const char *path, mxml_node_t **out_manifest, uint32_t *out_manifest_end)
+{
+  if (path == NULL || out_manifest == NULL || out_manifest_end == NULL)
+    return IFS_INVALID_PARAM;
+
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return IFS_FILE_FAILED;
+
+  ifs_error e = load_manifest(file, out_manifest, out_manifest_end);
+  fclose(file);
+  return e;
+}
+
+static int is_file_node(mxml_node_t *node)
+{
+  // files are stored as "offset size time".
+  if (mxmlGetType(node) != MXML_ELEMENT)
+    return 0;
+
+  const char *type = mxmlElementGetAttr(node, "__type");
+  return type != NULL && strcmp(type, "3s32") == 0;
+}
+
+static uint32_t get_node_path(mxml_node_t *node, char *out_path, uint32_t path_size)
+{
+  // collect the node and its ancestors, the document root (<?xml>) isn't part of the path.
+  // returns 0 if the path doesn't fit or is nested deeper than MAX_MANIFEST_DEPTH.
+  const char *names[MAX_MANIFEST_DEPTH];
+  uint32_t depth = 0;
+  for (; node != NULL && mxmlGetParent(node) != NULL; node = mxmlGetParent(node))
+  {
+    if (depth == MAX_MANIFEST_DEPTH)
+      return 0;
+    names[depth++] = mxmlGetElement(node);
+  }
+
+  // join them root first.
+  uint32_t length = 0;
+  while (depth--)
+  {
+    int written = snprintf(out_path + length, path_size - length, depth ? "%s/" : "%s", names[depth]);
+    if (written < 0 || (uint32_t) written >= path_size - length)
+      return 0;
+    length += (uint32_t) written;
+  }
+
+  return length;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+  return strcmp(((const ifs_entry*) a)->path, ((const ifs_entry*) b)->path);
+}
+
+static int compare_entry_path(const void *path, const void *entry)
+{
+  return strcmp((const char*) path, ((const ifs_entry*) entry)->path);
+}
+
+static ifs_error build_entries(ifs_archive *archive, mxml_node_t *manifest)
+{
+  // first pass counts files and the space needed for their paths.
+  char path[512];
+  uint32_t entry_count = 0;
+  size_t paths_size = 0;
+  for (mxml_node_t *node = mxmlWalkNext(manifest, manifest, MXML_DESCEND); node != NULL;
+       node = mxmlWalkNext(node, manifest, MXML_DESCEND))
+  {
+    if (!is_file_node(node))
+      continue;
+
+    uint32_t length = get_node_path(node, path, sizeof(path));
+    if (length == 0)
+      return IFS_MANIFEST_PARSE_ERROR;
+    ++entry_count;
+    paths_size += length + 1;
+  }
+
+  archive->entries = (ifs_entry*) allocator_calloc(entry_count ? entry_count : 1, sizeof(ifs_entry));
+  archive->paths = (char*) allocator_malloc(paths_size ? paths_size : 1);
+  if (archive->entries == NULL || archive->paths == NULL)
+    return IFS_MEM_FAILED;
+
+  // second pass fills them in.
+  char *cur_path = archive->paths;
+  for (mxml_node_t *node = mxmlWalkNext(manifest, manifest, MXML_DESCEND); node != NULL;
+       node = mxmlWalkNext(node, manifest, MXML_DESCEND))
+  {
+    if (!is_file_node(node))
+      continue;
+
+    const char *text = mxmlGetText(node, NULL);
+    if (text == NULL)
+      return IFS_MANIFEST_PARSE_ERROR;
+    char *endptr = NULL;
+    uint64_t offset = strtoul(text, &endptr, 10) + (uint64_t) archive->manifest_end;
+    uint64_t size = strtoul(endptr, NULL, 10);
+    if (offset + size > archive->file_size)
+      return IFS_INVALID_FILE;
+
+    uint32_t length = get_node_path(node, cur_path, (uint32_t) (paths_size - (cur_path - archive->paths)));
+    ifs_entry *entry = &archive->entries[archive->entry_count++];
+    entry->path = cur_path;
+    entry->offset = (uint32_t) offset;
+    entry->size = (uint32_t) size;
+    cur_path += length + 1;
+  }
+
+  qsort(archive->entries, archive->entry_count, sizeof(ifs_entry), compare_entries);
+  return IFS_NO_ERROR;
+}
+
+static void map_archive(ifs_archive *archive)
+{
+  // mapping is only an optimisation, reads still work when it fails.
+  archive->mapping = NULL;
+  if (archive->file_size == 0 || archive->file_size > SIZE_MAX)
+    return;
+
+#ifdef _WIN32
+  HANDLE file = (HANDLE) _get_osfhandle(_fileno(archive->file));
+  archive->mapping_handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (archive->mapping_handle == NULL)
+    return;
+  archive->mapping = (const uint8_t*) MapViewOfFile(archive->mapping_handle, FILE_MAP_READ, 0, 0, 0);
+  if (archive->mapping == NULL)
+  {
+    CloseHandle(archive->mapping_handle);
+    archive->mapping_handle = NULL;
+  }
+#else
+  void *mapping = mmap(NULL, (size_t) archive->file_size, PROT_READ, MAP_SHARED, fileno(archive->file), 0);
+  if (mapping != MAP_FAILED)
+    archive->mapping = (const uint8_t*) mapping;
+#endif
+}
+
+ifs_error ifs_open(const char *path, ifs_archive **out_archive)
+{
+  if (path == NULL || out_archive == NULL)
+    return IFS_INVALID_PARAM;
+
+  ifs_archive *archive = (ifs_archive*) allocator_calloc(1, sizeof(ifs_archive));
+  if (archive == NULL)
+    return IFS_MEM_FAILED;
+
+  TRACE_BEGIN("file_open");
+  archive->file = fopen(path, "rb");
+  TRACE_END("file_open");
+  if (archive->file == NULL)
+  {
+    allocator_free(archive);
+    return IFS_FILE_FAILED;
+  }
+
+  // entries are validated against the archive's size.
+#ifdef _WIN32
+  struct _stat64 st;
+  int stat_failed = _fstat64(_fileno(archive->file), &st);
+#else
+  struct stat st;
+  int stat_failed = fstat(fileno(archive->file), &st);
+#endif
+  if (stat_failed)
+  {
+    ifs_close(archive);
+    return IFS_FILE_FAILED;
+  }
+  archive->file_size = (uint64_t) st.st_size;
+  archive->file_mtime = (int64_t) st.st_mtime;
+
+  // decode the manifest once, keeping only the flat entry table.
+  allocator_stage previous_stage = allocator_set_stage(ALLOCATOR_STAGE_MANIFEST);
+  mxml_node_t *manifest = NULL;
+  ifs_error e = load_manifest(archive->file, &manifest, &archive->manifest_end);
+  if (e == IFS_NO_ERROR)
+  {
+    TRACE_BEGIN("build_entries");
+    e = build_entries(archive, manifest);
+    mxmlDelete(manifest);
+    TRACE_END("build_entries");
+  }
+  allocator_set_stage(previous_stage);
+  if (e != IFS_NO_ERROR)
+  {
+    ifs_close(archive);
+    return e;
+  }
+
+  map_archive(archive);
+
+  *out_archive = archive;
+  return IFS_NO_ERROR;
+}
+
+void ifs_close(ifs_archive *archive)
+{
+  if (archive == NULL)
+    return;
+
+#ifdef _WIN32
+  if (archive->mapping != NULL)
+  {
+    UnmapViewOfFile(archive->mapping);
+    CloseHandle(archive->mapping_handle);
+  }
+#else
+  if (archive->mapping != NULL)
+    munmap((void*) archive->mapping, (size_t) archive->file_size);
+#endif
+
+  if (archive->file != NULL)
+    fclose(archive->file);
+  allocator_free(archive->entries);
+  allocator_free(archive->paths);
+  allocator_free(archive);
+}
+
+void ifs_get_file_stamp(const ifs_archive *archive, uint64_t *out_size, int64_t *out_mtime)
+{
+  if (archive == NULL || out_size == NULL || out_mtime == NULL)
+    return;
+
+  *out_size = archive->file_size;
+  *out_mtime = archive->file_mtime;
+}
+
+uint32_t ifs_get_entry_count(const ifs_archive *archive)
+{
+  return archive == NULL ? 0 : archive->entry_count;
+}
+
+const ifs_entry *ifs_get_entry(const ifs_archive *archive, uint32_t index)
+{
+  if (archive == NULL || index >= archive->entry_count)
+    return NULL;
+
+  return &archive->entries[index];
+}
+
+const ifs_entry *ifs_find_entry(const ifs_archive *archive, const char *path)
+{
+  if (archive == NULL || path == NULL)
+    return NULL;
+
+  return (const ifs_entry*) bsearch(path, archive->entries, archive->entry_count, sizeof(ifs_entry), compare_entry_path);
+}
+
+ifs_error ifs_read_entry(const ifs_archive *archive, const ifs_entry *entry, uint32_t offset, void *out, uint32_t size)
+{
+  if (archive == NULL || entry == NULL || out == NULL || offset > entry->size || size > entry->size - offset)
+    return IFS_INVALID_PARAM;
+  if (size == 0)
+    return IFS_NO_ERROR;
+
+  // serve from the mapping when there is one.
+  if (archive->mapping != NULL)
+  {
+    memcpy(out, archive->mapping + entry->offset + offset, size);
+    return IFS_NO_ERROR;
+  }
+
+  // concurrent reads of the same archive don't share a file position.
+#ifdef _WIN32
+  int fd = _fileno(archive->file);
+#else
+  int fd = fileno(archive->file);
+#endif
+  return file_read_at(fd, (uint64_t) entry->offset + offset, out, size) ? IFS_FILE_FAILED : IFS_NO_ERROR;
+}
+
+ifs_error ifs_map_entry(const ifs_archive *archive, const ifs_entry *entry, const uint8_t **out_data)
+{
+  if (archive == NULL || entry == NULL || out_data == NULL)
+    return IFS_INVALID_PARAM;
+  if (archive->mapping == NULL)
+    return IFS_MAP_FAILED;
+
+  *out_data = archive->mapping + entry->offset;
+  return IFS_NO_ERROR;
+}
+
+void ifs_will_need_entry(const ifs_archive *archive, const ifs_entry *entry, uint32_t offset, uint32_t size)
+{
+  if (archive == NULL || entry == NULL || offset > entry->size || size > entry->size - offset || size == 0)
+    return;
+
+#ifdef _WIN32
+  (void) archive;
+#else
+  uint64_t position = (uint64_t) entry->offset + offset;
+  if (archive->mapping != NULL)
+  {
+    // madvise wants a page aligned start.
+    uint64_t page_size = (uint64_t) sysconf(_SC_PAGESIZE);
+    uint64_t start = position - position % page_size;
+    madvise((void*) (archive->mapping + start), (size_t) (position + size - start), MADV_WILLNEED);
+  }
+#if defined(POSIX_FADV_WILLNEED)
+  else
+    posix_fadvise(fileno(archive->file), (off_t) position, (off_t) size, POSIX_FADV_WILLNEED);
+#endif
+#endif
+}
+
+int ifs_unescape_name(const char *name, char *out_name, uint32_t name_size)
+{
+  if (name == NULL || out_name == NULL || name_size == 0)
+    return -1;
+
+  // names starting with a digit get a leading underscore.
+  if (name[0] == '_' && name[1] >= '0' && name[1] <= '9')
+    ++name;
+
+  // "_E" is a '.', "__" is a '_'.
+  uint32_t length = 0;
+  for (; *name; ++name)
+  {
+    if (length + 1 >= name_size)
+      return -1;
+
+    if (name[0] == '_' && name[1] == 'E')
+    {
+      out_name[length++] = '.';
+      ++name;
+    }
+    else if (name[0] == '_' && name[1] == '_')
+    {
+      out_name[length++] = '_';
+      ++name;
+    }
+    else
+      out_name[length++] = *name;
+  }
+
+  out_name[length] = 0;
+  return 0;
+}
+
+#ifndef _WIN32
+static ifs_error copy_to_fd(const ifs_archive *archive, const ifs_entry *entry, int out_fd)
+{
+  int in_fd = fileno(archive->file);
+  uint32_t remaining = entry->size;
+  unsigned methods = atomic_load(&copy_methods);
+
+#ifdef __linux__
+  // copy inside the kernel, this can even share extents on filesystems that support reflinks.
+  loff_t in_offset = entry->offset;
+  while (remaining > 0 && (methods & IFS_COPY_FILE_RANGE))
+  {
+    ssize_t copied = copy_file_range(in_fd, &in_offset, out_fd, NULL, remaining, 0);
+    if (copied <= 0)
+      break;
+    remaining -= (uint32_t) copied;
+  }
+
+  // copy_file_range isn't supported everywhere (older kernels, some filesystems), sendfile still avoids userspace.
+  off_t sendfile_offset = (off_t) in_offset;
+  while (remaining > 0 && (methods & IFS_COPY_SENDFILE))
+  {
+    ssize_t copied = sendfile(out_fd, in_fd, &sendfile_offset, remaining);
+    if (copied <= 0)
+      break;
+    remaining -= (uint32_t) copied;
+  }
+#else
+  (void) in_fd;
+#endif
+
+  // last resort, write straight out of the mapping or fall back to chunked reads.
+  uint32_t offset = entry->size - remaining;
+  uint8_t chunk[EXTRACT_CHUNK_SIZE];
+  while (remaining > 0)
+  {
+    const uint8_t *data;
+    uint32_t size = remaining;
+    if (archive->mapping != NULL && (methods & IFS_COPY_MAPPING))
+      data = archive->mapping + entry->offset + offset;
+    else
+    {
+      size = remaining < sizeof(chunk) ? remaining : (uint32_t) sizeof(chunk);
+      if (ifs_read_entry(archive, entry, offset, chunk, size) != IFS_NO_ERROR)
+        return IFS_FILE_FAILED;
+      data = chunk;
+    }
+
+    ssize_t written = write(out_fd, data, size);
+    if (written <= 0)
+      return IFS_FILE_FAILED;
+    offset += (uint32_t) written;
+    remaining -= (uint32_t) written;
+  }
+
+  return IFS_NO_ERROR;
+}
+#endif
+
+void ifs_set_copy_methods(unsigned methods)
+{
+  atomic_store(&copy_methods, methods & IFS_COPY_ALL);
+}
+
+ifs_error ifs_extract_entry(const ifs_archive *archive, const ifs_entry *entry, const char *out_path)
+{
+  if (archive == NULL || entry == NULL || out_path == NULL)
+    return IFS_INVALID_PARAM;
+
+  // the entry is written to a temporary file next to out_path and only renamed over it once complete. readers prefer
+  // an extracted .1 over its ifs, so a failed or interrupted extraction must never leave a partial one behind.
+  char temp_path[1024];
+#ifdef _WIN32
+  int length = snprintf(temp_path, sizeof(temp_path), "%s.%lu.%lu.tmp", out_path, (unsigned long) GetCurrentProcessId(),
+                        (unsigned long) GetCurrentThreadId());
+  if (length < 0 || (size_t) length >= sizeof(temp_path))
+    return IFS_INVALID_PARAM;
+  FILE *out = fopen(temp_path, "wb");
+  if (out == NULL)
+    return IFS_FILE_FAILED;
+
+  ifs_error e = IFS_NO_ERROR;
+  if (archive->mapping != NULL && (atomic_load(&copy_methods) & IFS_COPY_MAPPING))
+  {
+    if (fwrite(archive->mapping + entry->offset, 1, entry->size, out) < entry->size)
+      e = IFS_FILE_FAILED;
+  }
+  else
+  {
+    uint8_t chunk[EXTRACT_CHUNK_SIZE];
+    for (uint32_t offset = 0; offset < entry->size && e == IFS_NO_ERROR; offset += sizeof(chunk))
+    {
+      uint32_t size = entry->size - offset < sizeof(chunk) ? entry->size - offset : (uint32_t) sizeof(chunk);
+      e = ifs_read_entry(archive, entry, offset, chunk, size);
+      if (e == IFS_NO_ERROR && fwrite(chunk, 1, size, out) < size)
+        e = IFS_FILE_FAILED;
+    }
+  }
+
+  if (fclose(out) != 0 && e == IFS_NO_ERROR)
+    e = IFS_FILE_FAILED;
+  if (e == IFS_NO_ERROR && !MoveFileExA(temp_path, out_path, MOVEFILE_REPLACE_EXISTING))
+    e = IFS_FILE_FAILED;
+  if (e != IFS_NO_ERROR)
+    remove(temp_path);
+  return e;
+#else
+  int length = snprintf(temp_path, sizeof(temp_path), "%s.XXXXXX", out_path);
+  if (length < 0 || (size_t) length >= sizeof(temp_path))
+    return IFS_INVALID_PARAM;
+  int out_fd = mkstemp(temp_path);
+  if (out_fd < 0)
+    return IFS_FILE_FAILED;
+
+  // mkstemp creates the file private to us, extracted files are readable like any other.
+  ifs_error e = fchmod(out_fd, 0644) == 0 ? copy_to_fd(archive, entry, out_fd) : IFS_FILE_FAILED;
+  if (close(out_fd) != 0 && e == IFS_NO_ERROR)
+    e = IFS_FILE_FAILED;
+  if (e == IFS_NO_ERROR && rename(temp_path, out_path) != 0)
+    e = IFS_FILE_FAILED;
+  if (e != IFS_NO_ERROR)
+    unlink(temp_path);
+  return e;
+#endif
+}
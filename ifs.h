@@ -21,10 +21,49 @@ typedef enum
   IFS_MEM_FAILED = 3,
   IFS_INVALID_FILE = 4,
   IFS_MANIFEST_PARSE_ERROR = 5,
+  IFS_MAP_FAILED = 6,
 } ifs_error;
 
+// an opened ifs, the header and manifest are only decoded once in ifs_open.
+typedef struct ifs_archive_s ifs_archive;
+
+typedef struct
+{
+  const char *path; // escaped manifest path, e.g. "imgfs/_01000/_01000_E1".
+  uint32_t offset; // absolute offset within the ifs.
+  uint32_t size;
+} ifs_entry;
+
 ifs_error ifs_extract_manifest(const char *path, mxml_node_t **out_manifest, uint32_t *out_manifest_end);
 
+// create/destroy functions.
+ifs_error ifs_open(const char *path, ifs_archive **out_archive);
+void ifs_close(ifs_archive *archive);
+
+// size and modification time (in seconds) of the archive when it was opened.
+void ifs_get_file_stamp(const ifs_archive *archive, uint64_t *out_size, int64_t *out_mtime);
+
+// entries are sorted by path and stay valid until the archive is closed.
+uint32_t ifs_get_entry_count(const ifs_archive *archive);
+const ifs_entry *ifs_get_entry(const ifs_archive *archive, uint32_t index);
+const ifs_entry *ifs_find_entry(const ifs_archive *archive, const char *path);
+
+// copies size bytes starting offset bytes into the entry.
+ifs_error ifs_read_entry(const ifs_archive *archive, const ifs_entry *entry, uint32_t offset, void *out, uint32_t size);
+
+// zero-copy view of the entry's bytes, valid until the archive is closed.
+ifs_error ifs_map_entry(const ifs_archive *archive, const ifs_entry *entry, const uint8_t **out_data);
+
+// asks the os to start reading size bytes at offset into the entry in the background. only a hint.
+void ifs_will_need_entry(const ifs_archive *archive, const ifs_entry *entry, uint32_t offset, uint32_t size);
+
+// writes an entry to out_path, copying inside the kernel where possible (copy_file_range/sendfile).
+// out_path only appears (or is replaced) once the whole entry was written, failures leave it as it was.
+ifs_error ifs_extract_entry(const ifs_archive *archive, const ifs_entry *entry, const char *out_path);
+
+// converts a single manifest name to its file name, e.g. "_01000_E1" -> "01000.1".
+int ifs_unescape_name(const char *name, char *out_name, uint32_t name_size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,27 @@
+#ifndef IFS_INTERNAL_H_
+#define IFS_INTERNAL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// knobs for testing ifs.c, not part of the archive api.
+
+// the ways ifs_extract_entry may copy, tried in this order before falling back to reading and writing chunks.
+typedef enum
+{
+  IFS_COPY_FILE_RANGE = 1 << 0, // copy_file_range, linux only.
+  IFS_COPY_SENDFILE = 1 << 1, // sendfile, linux only.
+  IFS_COPY_MAPPING = 1 << 2, // writing straight out of the archive's mapping.
+  IFS_COPY_ALL = 0x7,
+} ifs_copy_method;
+
+// limits the copies ifs_extract_entry tries to a mask of ifs_copy_method, process-wide. everything is allowed by
+// default, turning methods off lets the tests reach the fallbacks.
+void ifs_set_copy_methods(unsigned methods);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IFS_INTERNAL_H_
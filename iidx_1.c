@@ -2,11 +2,20 @@
 
 #include <string.h>
 
+#include "allocator.h"
+
 #define BINARY_STREAM_DEFINITIONS
+#define BINARY_STREAM_MALLOC(size) allocator_malloc(size)
+#define BINARY_STREAM_FREE(ptr) allocator_free(ptr)
 #include "binary_stream.h"
+#include "chart_cache.h"
+#include "trace.h"
 
 #define CHART_END_SIGNATURE 0x7fffffff
 
+// events decoded per block by iidx_1_decode_events, 2kb of chart data.
+#define DECODE_BLOCK_SIZE 256
+
 typedef struct
 {
   struct
@@ -16,7 +25,116 @@ typedef struct
   } charts[IIDX_1_MAX_CHART_COUNT];
 } iidx_1_header;
 
-static int get_note_count(uint8_t *chart, uint32_t length)
+static inline uint32_t load_u32_le(const uint8_t *data)
+{
+  uint32_t ret;
+  memcpy(&ret, data, sizeof(ret));
+  return BINARY_STREAM_HOST_BIG_ENDIAN ? byte_swap32(ret) : ret;
+}
+
+static inline uint16_t load_u16_le(const uint8_t *data)
+{
+  uint16_t ret;
+  memcpy(&ret, data, sizeof(ret));
+  return BINARY_STREAM_HOST_BIG_ENDIAN ? byte_swap16(ret) : ret;
+}
+
+// how much an event adds to the note count. notes are types 0 and 1 (1p/2p), charge notes (value > 0) count twice.
+static inline uint32_t get_note_weight(uint8_t type, uint16_t value)
+{
+  return type <= 0x01 ? (value > 0 ? 2 : 1) : 0;
+}
+
+// state for the density analysis, lives on the stack for the duration of one chart scan.
+typedef struct
+{
+  uint32_t window;
+
+  // sliding window of recent notes, the events from tail up to the current one. the chart is already in memory, so the
+  // window trails behind the scan over the same events instead of keeping a copy.
+  const uint8_t *chart;
+  uint32_t tail;
+  uint32_t window_notes;
+
+  // fixed (non-overlapping) window currently being filled for the histogram.
+  uint32_t bucket_start;
+  uint32_t bucket_notes;
+
+  iidx_1_note_density *out;
+} density_tracker;
+
+static void density_init(density_tracker *tracker, const uint8_t *chart, uint32_t window, iidx_1_note_density *out)
+{
+  memset(out, 0, sizeof(*out));
+  tracker->window = window;
+  tracker->chart = chart;
+  tracker->tail = 0;
+  tracker->window_notes = 0;
+  tracker->bucket_start = 0;
+  tracker->bucket_notes = 0;
+  tracker->out = out;
+}
+
+static void density_close_bucket(density_tracker *tracker)
+{
+  uint32_t bucket = tracker->bucket_notes;
+  if (bucket >= IIDX_1_DENSITY_BUCKET_COUNT)
+    bucket = IIDX_1_DENSITY_BUCKET_COUNT - 1;
+  ++tracker->out->histogram[bucket];
+  tracker->bucket_notes = 0;
+}
+
+static void density_flush_buckets(density_tracker *tracker, uint32_t offset)
+{
+  // close every fixed window that ends at or before offset, empty ones included.
+  if (offset < tracker->bucket_start || offset - tracker->bucket_start < tracker->window)
+    return;
+
+  // the current window, then all the empty ones in between at once. a far off offset with a small window would
+  // otherwise take a step per window.
+  uint32_t skipped = (offset - tracker->bucket_start) / tracker->window;
+  density_close_bucket(tracker);
+  tracker->out->histogram[0] += skipped - 1;
+  tracker->bucket_start += skipped * tracker->window;
+}
+
+static void density_add_note(density_tracker *tracker, uint32_t position, uint32_t offset, uint32_t weight)
+{
+  // expire notes that have slid out of the window (offset - window, offset], position is where this note's event starts.
+  for (; tracker->tail < position; tracker->tail += 8)
+  {
+    const uint8_t *event = tracker->chart + tracker->tail;
+    uint32_t tail_weight = get_note_weight(event[4], load_u16_le(event + 6));
+    if (tail_weight == 0)
+      continue;
+
+    uint32_t tail_offset = load_u32_le(event);
+    if (offset < tail_offset || offset - tail_offset < tracker->window)
+      break;
+    tracker->window_notes -= tail_weight;
+  }
+  tracker->window_notes += weight;
+
+  if (tracker->window_notes > tracker->out->peak_density)
+  {
+    tracker->out->peak_density = tracker->window_notes;
+    tracker->out->peak_offset = offset;
+  }
+
+  density_flush_buckets(tracker, offset);
+  tracker->bucket_notes += weight;
+}
+
+static void density_finish(density_tracker *tracker)
+{
+  // close the remaining windows up to (and including) the one holding the final event.
+  density_flush_buckets(tracker, tracker->out->duration);
+  if (tracker->out->duration > 0 || tracker->bucket_notes > 0)
+    density_close_bucket(tracker);
+}
+
+// counts the notes in a chart, optionally running the density analysis in the same pass.
+static int scan_chart(uint8_t *chart, uint32_t length, density_tracker *tracker)
 {
   // validate parameters, length MUST be a multiple of 8.
   if (chart == NULL || (length & 0x07))
@@ -24,46 +142,100 @@ static int get_note_count(uint8_t *chart, uint32_t length)
   if (length == 0)
     return 0;
   
+  TRACE_BEGIN_VALUE("get_note_count", length);
+
   // open chart for as binary stream.
+  allocator_stage previous_stage = allocator_set_stage(ALLOCATOR_STAGE_SCAN);
   binary_stream *bs = bs_open(chart, length);
+  allocator_set_stage(previous_stage);
   int note_count = 0;
   while (!bs_at_end(bs))
   {
     // read in 8 bytes.
-    uint32_t event_offset = bs_read_u32(bs);
+    uint32_t event_offset = bs_read_u32_le(bs);
     uint8_t event_type = bs_read_u8(bs);
     uint8_t event_param = bs_read_u8(bs);
-    uint16_t event_value = bs_read_u16(bs);
+    uint16_t event_value = bs_read_u16_le(bs);
 
     // check if end of chart.
     if (event_offset == CHART_END_SIGNATURE)
       break;
 
-    // check if it's a note. (0x00 == 1p note, 0x01 == 2p note)
-    if (event_type == 0x00 || event_type == 0x01)
+    if (tracker != NULL && event_offset > tracker->out->duration)
+      tracker->out->duration = event_offset;
+
+    uint32_t weight = get_note_weight(event_type, event_value);
+    if (weight > 0)
     {
-      // check if it's a charge note.
-      note_count += event_value > 0 ? 2 : 1;
+      note_count += (int) weight;
+      if (tracker != NULL)
+        density_add_note(tracker, bs_get_offset(bs) - 8, event_offset, weight);
     }
   }
 
   bs_close(bs);
+  TRACE_END("get_note_count");
+
+  if (tracker != NULL)
+  {
+    tracker->out->note_count = note_count;
+    density_finish(tracker);
+  }
   return note_count;
 }
 
+static int get_note_count(uint8_t *chart, uint32_t length)
+{
+  return scan_chart(chart, length, NULL);
+}
+
+static uint32_t count_events(const uint8_t *chart, uint32_t length)
+{
+  uint32_t count = 0;
+  while (count < length / 8 && load_u32_le(chart + count * 8) != CHART_END_SIGNATURE)
+    ++count;
+  return count;
+}
+
+static int get_chart_range(const uint8_t *header, uint32_t file_length, iidx_1_chart chart, uint32_t *out_offset,
+                           uint32_t *out_length)
+{
+  // make sure the chart's byte range actually lies within the file.
+  uint32_t offset = load_u32_le(header + chart * 8);
+  uint32_t length = load_u32_le(header + chart * 8 + 4);
+  if (offset > file_length || length > file_length - offset)
+    return -1;
+
+  *out_offset = offset;
+  *out_length = length;
+  return 0;
+}
+
+static int get_chart(uint8_t *file, uint32_t file_length, iidx_1_chart chart, uint8_t **out_chart, uint32_t *out_length)
+{
+  uint32_t offset;
+  if (get_chart_range(file, file_length, chart, &offset, out_length))
+    return -1;
+
+  *out_chart = file + offset;
+  return 0;
+}
+
 int iidx_1_get_note_counts(uint8_t *file, uint32_t file_length, iidx_1_note_counts *out_note_counts)
 {
   if (file == NULL || file_length < sizeof(iidx_1_header) || out_note_counts == NULL)
     return -1;
 
-  // read file header.
-  iidx_1_header header;
-  memcpy(&header, file, sizeof(header));
   iidx_1_note_counts note_counts;
   for (int i = 0; i < IIDX_1_MAX_CHART_COUNT; ++i)
   {
     // get note counts for all charts.
-    note_counts.charts[i] = get_note_count(file + header.charts[i].offset, header.charts[i].length);
+    uint8_t *chart;
+    uint32_t length;
+    if (get_chart(file, file_length, (iidx_1_chart) i, &chart, &length))
+      note_counts.charts[i] = -1;
+    else
+      note_counts.charts[i] = get_note_count(chart, length);
   }
 
   *out_note_counts = note_counts;
@@ -74,7 +246,177 @@ int iidx_1_get_note_count(uint8_t *file, uint32_t file_length, iidx_1_chart char
 {
   if (file == NULL || file_length < sizeof(iidx_1_header) || (uint32_t) chart >= IIDX_1_MAX_CHART_COUNT)
     return -1;
-  
-  iidx_1_header *header = (iidx_1_header*) file;
-  return get_note_count(file + header->charts[chart].offset, header->charts[chart].length);
+
+  uint8_t *chart_data;
+  uint32_t length;
+  if (get_chart(file, file_length, chart, &chart_data, &length))
+    return -1;
+
+  return get_note_count(chart_data, length);
+}
+
+int iidx_1_get_chart_range(const uint8_t *header, uint32_t file_length, iidx_1_chart chart, uint32_t *out_offset,
+                            uint32_t *out_length)
+{
+  if (header == NULL || file_length < sizeof(iidx_1_header) || (uint32_t) chart >= IIDX_1_MAX_CHART_COUNT ||
+      out_offset == NULL || out_length == NULL)
+    return -1;
+
+  return get_chart_range(header, file_length, chart, out_offset, out_length);
+}
+
+int iidx_1_get_chart_note_count(uint8_t *chart, uint32_t length)
+{
+  return get_note_count(chart, length);
+}
+
+int iidx_1_count_event_notes(const uint8_t *events, uint32_t length, int *out_end)
+{
+  if (events == NULL || (length & 0x07) || out_end == NULL)
+    return -1;
+
+  int note_count = 0;
+  *out_end = 0;
+  for (uint32_t i = 0; i < length; i += 8)
+  {
+    if (load_u32_le(events + i) == CHART_END_SIGNATURE)
+    {
+      *out_end = 1;
+      break;
+    }
+
+    note_count += (int) get_note_weight(events[i + 4], load_u16_le(events + i + 6));
+  }
+
+  return note_count;
+}
+
+int iidx_1_get_note_counts_cached(uint8_t *file, uint32_t file_length, chart_cache *cache, iidx_1_note_counts *out_note_counts)
+{
+  if (cache == NULL)
+    return iidx_1_get_note_counts(file, file_length, out_note_counts);
+  if (file == NULL || file_length < sizeof(iidx_1_header) || out_note_counts == NULL)
+    return -1;
+
+  iidx_1_note_counts note_counts;
+  for (int i = 0; i < IIDX_1_MAX_CHART_COUNT; ++i)
+  {
+    uint8_t *chart;
+    uint32_t length;
+    if (get_chart(file, file_length, (iidx_1_chart) i, &chart, &length))
+    {
+      note_counts.charts[i] = -1;
+      continue;
+    }
+
+    // empty slots aren't worth hashing.
+    if (length == 0)
+    {
+      note_counts.charts[i] = 0;
+      continue;
+    }
+
+    // resolve byte-identical charts from the cache, only scanning charts we haven't seen.
+    uint64_t hash = chart_cache_hash(chart, length);
+    if (!chart_cache_find(cache, hash, length, &note_counts.charts[i]))
+    {
+      note_counts.charts[i] = get_note_count(chart, length);
+      chart_cache_insert(cache, hash, length, note_counts.charts[i]);
+    }
+  }
+
+  *out_note_counts = note_counts;
+  return 0;
+}
+
+int iidx_1_get_note_densities(uint8_t *file, uint32_t file_length, uint32_t window, iidx_1_note_densities *out_densities)
+{
+  if (file == NULL || file_length < sizeof(iidx_1_header) || window == 0 || out_densities == NULL)
+    return -1;
+
+  for (int i = 0; i < IIDX_1_MAX_CHART_COUNT; ++i)
+  {
+    if (iidx_1_get_note_density(file, file_length, (iidx_1_chart) i, window, &out_densities->charts[i]))
+      out_densities->charts[i].note_count = -1;
+  }
+
+  return 0;
+}
+
+int iidx_1_get_note_density(uint8_t *file, uint32_t file_length, iidx_1_chart chart, uint32_t window, iidx_1_note_density *out_density)
+{
+  if (file == NULL || file_length < sizeof(iidx_1_header) || (uint32_t) chart >= IIDX_1_MAX_CHART_COUNT ||
+      window == 0 || out_density == NULL)
+    return -1;
+
+  memset(out_density, 0, sizeof(*out_density));
+
+  uint8_t *chart_data;
+  uint32_t length;
+  if (get_chart(file, file_length, chart, &chart_data, &length))
+    return -1;
+
+  density_tracker tracker;
+  density_init(&tracker, chart_data, window, out_density);
+  return scan_chart(chart_data, length, &tracker) < 0 ? -1 : 0;
+}
+
+int iidx_1_get_event_count(uint8_t *file, uint32_t file_length, iidx_1_chart chart)
+{
+  if (file == NULL || file_length < sizeof(iidx_1_header) || (uint32_t) chart >= IIDX_1_MAX_CHART_COUNT)
+    return -1;
+
+  uint8_t *chart_data;
+  uint32_t length;
+  if (get_chart(file, file_length, chart, &chart_data, &length) || (length & 0x07))
+    return -1;
+
+  return (int) count_events(chart_data, length);
+}
+
+int iidx_1_decode_events(uint8_t *file, uint32_t file_length, iidx_1_chart chart, iidx_1_event_columns *columns)
+{
+  if (file == NULL || file_length < sizeof(iidx_1_header) || (uint32_t) chart >= IIDX_1_MAX_CHART_COUNT ||
+      columns == NULL)
+    return -1;
+
+  uint8_t *chart_data;
+  uint32_t length;
+  if (get_chart(file, file_length, chart, &chart_data, &length) || (length & 0x07))
+    return -1;
+
+  // find the end first, so every column below is a plain counted loop the compiler can vectorise.
+  uint32_t count = count_events(chart_data, length);
+  if (count > columns->capacity)
+    return -1;
+
+  TRACE_BEGIN_VALUE("decode_events", count);
+  // columns are filled a block at a time so the events are still in cache for every column after the first.
+  for (uint32_t start = 0; start < count; start += DECODE_BLOCK_SIZE)
+  {
+    uint32_t end = bs_min_u32(count, start + DECODE_BLOCK_SIZE);
+    if (columns->offsets != NULL)
+    {
+      for (uint32_t i = start; i < end; ++i)
+        columns->offsets[i] = load_u32_le(chart_data + i * 8);
+    }
+    if (columns->types != NULL)
+    {
+      for (uint32_t i = start; i < end; ++i)
+        columns->types[i] = chart_data[i * 8 + 4];
+    }
+    if (columns->params != NULL)
+    {
+      for (uint32_t i = start; i < end; ++i)
+        columns->params[i] = chart_data[i * 8 + 5];
+    }
+    if (columns->values != NULL)
+    {
+      for (uint32_t i = start; i < end; ++i)
+        columns->values[i] = load_u16_le(chart_data + i * 8 + 6);
+    }
+  }
+  TRACE_END("decode_events");
+
+  return (int) count;
 }
@@ -7,6 +7,8 @@ extern "C" {
 
 #include <stdint.h>
 
+#include "chart_cache.h"
+
 typedef enum
 {
   IIDX_1_SPH = 0,
@@ -26,9 +28,66 @@ typedef struct
   int charts[IIDX_1_MAX_CHART_COUNT];
 } iidx_1_note_counts;
 
+#define IIDX_1_DENSITY_BUCKET_COUNT 32
+
+// note density of a single chart. offsets and windows are in event offset units (ms).
+// charge notes count twice, the same as in the note counts.
+typedef struct
+{
+  int note_count;
+  uint32_t duration; // offset of the last event before the end of the chart.
+  uint32_t peak_density; // most notes inside any sliding window.
+  uint32_t peak_offset; // where the densest window ends.
+
+  // number of consecutive fixed windows holding N notes, the last bucket also holds everything above.
+  uint32_t histogram[IIDX_1_DENSITY_BUCKET_COUNT];
+} iidx_1_note_density;
+
+typedef struct
+{
+  iidx_1_note_density charts[IIDX_1_MAX_CHART_COUNT];
+} iidx_1_note_densities;
+
+// size of the header at the start of every .1 file, an offset/length pair per chart slot.
+#define IIDX_1_HEADER_SIZE 96
+
 int iidx_1_get_note_counts(uint8_t *file, uint32_t file_length, iidx_1_note_counts *out_note_counts);
 int iidx_1_get_note_count(uint8_t *file, uint32_t file_length, iidx_1_chart chart);
 
+// for reading a single chart without loading the whole file. header is the first IIDX_1_HEADER_SIZE bytes of the
+// file, file_length the size of the whole file. the range is checked to lie within the file.
+int iidx_1_get_chart_range(const uint8_t *header, uint32_t file_length, iidx_1_chart chart, uint32_t *out_offset,
+                           uint32_t *out_length);
+// counts the notes of a chart's bytes on their own, as located by iidx_1_get_chart_range.
+int iidx_1_get_chart_note_count(uint8_t *chart, uint32_t length);
+// counts the notes in a run of whole events, so a chart can be scanned a chunk at a time. *out_end is set once the
+// end of chart signature is reached, nothing after it is counted.
+int iidx_1_count_event_notes(const uint8_t *events, uint32_t length, int *out_end);
+
+// same as iidx_1_get_note_counts, but charts already seen by the cache are resolved by hash instead of rescanned.
+int iidx_1_get_note_counts_cached(uint8_t *file, uint32_t file_length, chart_cache *cache, iidx_1_note_counts *out_note_counts);
+
+// single pass note density analysis, window is the length of the sliding/histogram windows.
+// empty charts are reported with a zeroed density.
+int iidx_1_get_note_densities(uint8_t *file, uint32_t file_length, uint32_t window, iidx_1_note_densities *out_densities);
+int iidx_1_get_note_density(uint8_t *file, uint32_t file_length, iidx_1_chart chart, uint32_t window, iidx_1_note_density *out_density);
+
+// raw events of a chart decoded into separate caller-owned arrays (structure of arrays), one entry per event.
+// columns that aren't needed can be left NULL and are skipped entirely.
+typedef struct
+{
+  uint32_t *offsets;
+  uint8_t *types;
+  uint8_t *params;
+  uint16_t *values;
+  uint32_t capacity; // number of entries every non-NULL column has room for.
+} iidx_1_event_columns;
+
+// number of events before the end of chart signature, use it to size the columns.
+int iidx_1_get_event_count(uint8_t *file, uint32_t file_length, iidx_1_chart chart);
+// decodes every event of the chart into the columns and returns the event count, -1 if they are too small.
+int iidx_1_decode_events(uint8_t *file, uint32_t file_length, iidx_1_chart chart, iidx_1_event_columns *columns);
+
 #ifdef __cplusplus
 }
 #endif
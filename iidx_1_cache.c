@@ -0,0 +1,262 @@
+#include "iidx_1_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "iidx_note_count.h"
+#include "thread.h"
+
+#define BUCKET_COUNT 1024
+
+typedef struct cache_entry_s
+{
+  struct cache_entry_s *bucket_next;
+
+  // lru list, head is the most recently used.
+  struct cache_entry_s *lru_prev;
+  struct cache_entry_s *lru_next;
+
+  char music_id[IIDX_MUSIC_ID_SIZE];
+  iidx_1_cached_buffer *buffer; // NULL once evicted.
+  iidx_1_location location;
+  int has_location;
+} cache_entry;
+
+static mutex cache_mutex = MUTEX_INITIALIZER;
+// read without the mutex to skip a disabled cache, only changed with it held.
+static atomic_size_t cache_budget;
+static size_t cache_used;
+static cache_entry *buckets[BUCKET_COUNT];
+static cache_entry *lru_head;
+static cache_entry *lru_tail;
+
+static uint32_t hash_music_id(const char *music_id)
+{
+  // fnv-1a.
+  uint32_t hash = 2166136261u;
+  for (; *music_id; ++music_id)
+    hash = (hash ^ (uint8_t) *music_id) * 16777619u;
+  return hash & (BUCKET_COUNT - 1);
+}
+
+static cache_entry *find_entry(const char *music_id)
+{
+  for (cache_entry *entry = buckets[hash_music_id(music_id)]; entry != NULL; entry = entry->bucket_next)
+  {
+    if (strcmp(entry->music_id, music_id) == 0)
+      return entry;
+  }
+
+  return NULL;
+}
+
+static void lru_unlink(cache_entry *entry)
+{
+  if (entry->lru_prev != NULL)
+    entry->lru_prev->lru_next = entry->lru_next;
+  else
+    lru_head = entry->lru_next;
+  if (entry->lru_next != NULL)
+    entry->lru_next->lru_prev = entry->lru_prev;
+  else
+    lru_tail = entry->lru_prev;
+}
+
+static void lru_push_front(cache_entry *entry)
+{
+  entry->lru_prev = NULL;
+  entry->lru_next = lru_head;
+  if (lru_head != NULL)
+    lru_head->lru_prev = entry;
+  else
+    lru_tail = entry;
+  lru_head = entry;
+}
+
+static iidx_1_cached_buffer *acquire_buffer(iidx_1_cached_buffer *buffer)
+{
+  atomic_fetch_add_explicit(&buffer->references, 1, memory_order_relaxed);
+  return buffer;
+}
+
+static void drop_buffer(cache_entry *entry)
+{
+  if (entry->buffer == NULL)
+    return;
+
+  cache_used -= entry->buffer->length;
+  iidx_1_cache_release(entry->buffer);
+  entry->buffer = NULL;
+}
+
+static void remove_entry(cache_entry *entry)
+{
+  drop_buffer(entry);
+  lru_unlink(entry);
+
+  cache_entry **link = &buckets[hash_music_id(entry->music_id)];
+  while (*link != entry)
+    link = &(*link)->bucket_next;
+  *link = entry->bucket_next;
+
+  cache_used -= sizeof(cache_entry);
+  allocator_free(entry);
+}
+
+static cache_entry *use_entry(const char *music_id)
+{
+  // finds or adds the song's entry and makes it the most recently used, NULL if it can't be allocated.
+  cache_entry *entry = find_entry(music_id);
+  if (entry != NULL)
+  {
+    lru_unlink(entry);
+    lru_push_front(entry);
+    return entry;
+  }
+
+  allocator_stage previous_stage = allocator_set_stage(ALLOCATOR_STAGE_INDEX);
+  entry = (cache_entry*) allocator_calloc(1, sizeof(cache_entry));
+  allocator_set_stage(previous_stage);
+  if (entry == NULL)
+    return NULL;
+
+  strcpy(entry->music_id, music_id);
+  uint32_t bucket = hash_music_id(music_id);
+  entry->bucket_next = buckets[bucket];
+  buckets[bucket] = entry;
+  lru_push_front(entry);
+  cache_used += sizeof(cache_entry);
+  return entry;
+}
+
+static void evict(void)
+{
+  // buffers go first, least recently used first. locations are cheap, they only go once that isn't enough.
+  size_t budget = atomic_load_explicit(&cache_budget, memory_order_relaxed);
+  for (cache_entry *entry = lru_tail; entry != NULL && cache_used > budget; entry = entry->lru_prev)
+    drop_buffer(entry);
+  while (cache_used > budget && lru_tail != NULL)
+    remove_entry(lru_tail);
+}
+
+int iidx_1_cache_set_budget(size_t budget)
+{
+  mutex_lock(&cache_mutex);
+  atomic_store_explicit(&cache_budget, budget, memory_order_relaxed);
+  evict();
+  mutex_unlock(&cache_mutex);
+
+  return 0;
+}
+
+void iidx_1_cache_clear(void)
+{
+  mutex_lock(&cache_mutex);
+  while (lru_tail != NULL)
+    remove_entry(lru_tail);
+  mutex_unlock(&cache_mutex);
+}
+
+iidx_1_cached_buffer *iidx_1_cache_acquire(const char *music_id, iidx_1_location *out_location, int *out_has_location)
+{
+  iidx_1_cached_buffer *ret = NULL;
+  *out_has_location = 0;
+  if (atomic_load_explicit(&cache_budget, memory_order_relaxed) == 0)
+    return NULL;
+
+  mutex_lock(&cache_mutex);
+  cache_entry *entry = find_entry(music_id);
+  if (entry != NULL)
+  {
+    lru_unlink(entry);
+    lru_push_front(entry);
+
+    if (entry->buffer != NULL)
+      ret = acquire_buffer(entry->buffer);
+    if (entry->has_location)
+    {
+      *out_location = entry->location;
+      *out_has_location = 1;
+    }
+  }
+  mutex_unlock(&cache_mutex);
+
+  return ret;
+}
+
+iidx_1_cached_buffer *iidx_1_cache_insert(const char *music_id, uint8_t *data, uint32_t length, const iidx_1_location *location)
+{
+  iidx_1_cached_buffer *buffer = (iidx_1_cached_buffer*) allocator_malloc(sizeof(iidx_1_cached_buffer));
+  if (buffer == NULL)
+  {
+    allocator_free(data);
+    return NULL;
+  }
+  buffer->data = data;
+  buffer->length = length;
+  atomic_init(&buffer->references, 1);
+
+  if (atomic_load_explicit(&cache_budget, memory_order_relaxed) == 0 || strlen(music_id) >= IIDX_MUSIC_ID_SIZE)
+    return buffer;
+
+  mutex_lock(&cache_mutex);
+  size_t budget = atomic_load_explicit(&cache_budget, memory_order_relaxed);
+  if (sizeof(cache_entry) <= budget)
+  {
+    cache_entry *entry = use_entry(music_id);
+
+    // another thread may have loaded the same song in the meantime, the newest load wins.
+    // songs too big for the budget only keep their location.
+    if (entry != NULL)
+    {
+      drop_buffer(entry);
+      if (length + sizeof(cache_entry) <= budget)
+      {
+        entry->buffer = acquire_buffer(buffer);
+        cache_used += length;
+      }
+      if (location != NULL)
+      {
+        entry->location = *location;
+        entry->has_location = 1;
+      }
+      evict();
+    }
+  }
+  mutex_unlock(&cache_mutex);
+
+  return buffer;
+}
+
+void iidx_1_cache_insert_location(const char *music_id, const iidx_1_location *location)
+{
+  if (atomic_load_explicit(&cache_budget, memory_order_relaxed) == 0 || strlen(music_id) >= IIDX_MUSIC_ID_SIZE)
+    return;
+
+  mutex_lock(&cache_mutex);
+  if (sizeof(cache_entry) <= atomic_load_explicit(&cache_budget, memory_order_relaxed))
+  {
+    // a buffer the song already has is kept.
+    cache_entry *entry = use_entry(music_id);
+    if (entry != NULL)
+    {
+      entry->location = *location;
+      entry->has_location = 1;
+      evict();
+    }
+  }
+  mutex_unlock(&cache_mutex);
+}
+
+void iidx_1_cache_release(iidx_1_cached_buffer *buffer)
+{
+  if (buffer == NULL)
+    return;
+
+  if (atomic_fetch_sub_explicit(&buffer->references, 1, memory_order_acq_rel) == 1)
+  {
+    allocator_free(buffer->data);
+    allocator_free(buffer);
+  }
+}
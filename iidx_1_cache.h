@@ -0,0 +1,54 @@
+#ifndef IIDX_1_CACHE_H_
+#define IIDX_1_CACHE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// process-wide cache of loaded .1 files keyed by music id, bounded by a memory budget with lru eviction.
+// songs whose buffer was evicted keep where their .1 lives inside the ifs, so reloading skips the manifest.
+// cached buffers are what was on disk when they were loaded, call iidx_1_cache_clear after replacing song files.
+// locations check themselves, see iidx_1_location.
+
+typedef struct
+{
+  uint8_t *data;
+  uint32_t length;
+  atomic_int references;
+} iidx_1_cached_buffer;
+
+// where a song's .1 file lives inside its ifs. the archive's size and modification time are kept with it, once the
+// archive on disk no longer matches them the location is stale and the manifest has to be read again.
+typedef struct
+{
+  uint32_t offset;
+  uint32_t size;
+  uint64_t archive_size;
+  int64_t archive_mtime;
+} iidx_1_location;
+
+// 0 disables the cache and frees everything it holds, the other functions then return without locking.
+int iidx_1_cache_set_budget(size_t budget);
+void iidx_1_cache_clear(void);
+
+// returns the cached buffer with a reference added, or NULL on a miss. out_location is filled in if known.
+iidx_1_cached_buffer *iidx_1_cache_acquire(const char *music_id, iidx_1_location *out_location, int *out_has_location);
+
+// takes ownership of data and returns it with a reference added. the buffer isn't kept when caching is disabled
+// or it doesn't fit in the budget, the location still is.
+iidx_1_cached_buffer *iidx_1_cache_insert(const char *music_id, uint8_t *data, uint32_t length, const iidx_1_location *location);
+
+// remembers where the song's .1 lives without caching its contents, for reads that only touch part of the file.
+void iidx_1_cache_insert_location(const char *music_id, const iidx_1_location *location);
+
+void iidx_1_cache_release(iidx_1_cached_buffer *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IIDX_1_CACHE_H_
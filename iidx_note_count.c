@@ -1,81 +1,454 @@
 #include "iidx_note_count.h"
 
+#include <errno.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <string.h>
 
+#ifdef _WIN32
+  #include <direct.h>
+  #include <io.h>
+  #include <windows.h>
+  #define make_directory(path) _mkdir(path)
+#else
+  #include <fcntl.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+  #define make_directory(path) mkdir(path, 0755)
+#endif
+
+#include "allocator.h"
+#include "disk_order.h"
+#include "epoch.h"
+#include "file_io.h"
 #include "ifs.h"
+#include "iidx_1_cache.h"
+#include "sound_index.h"
+#include "thread.h"
+#include "trace.h"
+
+#define MAX_EXTRACT_THREADS 64
+
+// how many songs ahead of the current one batch lookups ask the os to read ahead.
+#define BATCH_READ_AHEAD 8
+// buffer streaming scans read charts through, a multiple of the 8 byte event size.
+#define STREAM_BUFFER_SIZE (16 * 1024)
+
+// installed by set_music_roots, NULL means songs are looked for in data/sound. queries read it without locking,
+// replaced indexes are freed once no query can still be using them (see epoch.h).
+static _Atomic(sound_index*) roots_index;
+
+// only taken by set_music_roots.
+static mutex roots_mutex = MUTEX_INITIALIZER;
+static epoch_retired *retired_indexes;
 
-static int load_iidx_1(const char *music_id, uint8_t **out_file_buffer, int *out_file_length)
+static int resolve_song(const char *music_id, char *out_path, size_t path_size, sound_format *out_format)
 {
-  uint8_t *file_buffer;
-  int file_length;
+  // returns 1 with the song's path if it's in the index, 0 if there is no index and -1 if the index doesn't have it.
+  epoch_record *record = epoch_enter();
+  if (record == NULL)
+    return -1;
+
+  int ret = 0;
+  const sound_index *index = atomic_load(&roots_index);
+  if (index != NULL)
+  {
+    const char *root;
+    ret = -1;
+    if (sound_index_find(index, music_id, &root, out_format) == 0)
+    {
+      int written = *out_format == SOUND_FORMAT_EXTRACTED ?
+        snprintf(out_path, path_size, "%s/%s/%s.1", root, music_id, music_id) :
+        snprintf(out_path, path_size, "%s/%s.ifs", root, music_id);
+      ret = written < 0 || (size_t) written >= path_size ? -1 : 1;
+    }
+  }
+  epoch_exit(record);
 
-  // check if .1 file already exists.
-  char filename[128];
-  snprintf(filename, sizeof(filename), "data/sound/%s/%s.1", music_id, music_id);
+  return ret;
+}
+
+// an opened .1 file, either on its own, inside an ifs we already know the location in, or inside an opened ifs.
+typedef struct
+{
+  FILE *file;
+  int fd; // read from when there is no archive, file's descriptor or one the caller passed in.
+  uint64_t base; // where the .1 starts in fd.
+  ifs_archive *archive;
+  const ifs_entry *entry;
+  uint32_t size;
+} iidx_1_source;
+
+static FILE *open_file(const char *filename)
+{
+  TRACE_BEGIN("file_open");
   FILE *file = fopen(filename, "rb");
+  TRACE_END("file_open");
+
+  // every read is already exactly the range we want, stdio buffering would only read past it.
   if (file != NULL)
+    setvbuf(file, NULL, _IONBF, 0);
+  return file;
+}
+
+static int open_extracted(const char *filename, iidx_1_source *out_source)
+{
+  FILE *file = open_file(filename);
+  if (file == NULL)
+    return -1;
+
+  fseek(file, 0, SEEK_END);
+  out_source->size = ftell(file);
+  out_source->file = file;
+  out_source->fd = fileno(file);
+  out_source->base = 0;
+  return 0;
+}
+
+static int open_ifs(const char *filename, const char *music_id, iidx_1_source *out_source, iidx_1_location *out_location)
+{
+  ifs_archive *archive = NULL;
+  if (ifs_open(filename, &archive) != IFS_NO_ERROR)
+    return -1;
+
+  // find our .1 file in the archive.
+  char manifest_path[128];
+  snprintf(manifest_path, sizeof(manifest_path), "imgfs/_%s/_%s_E1", music_id, music_id);
+  TRACE_BEGIN("manifest_lookup");
+  const ifs_entry *entry = ifs_find_entry(archive, manifest_path);
+  TRACE_END("manifest_lookup");
+  if (entry == NULL)
   {
-    // ifs already extracted, read the charts file.
-    fseek(file, 0, SEEK_END);
-    file_length = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    ifs_close(archive);
+    return -1;
+  }
+
+  out_source->archive = archive;
+  out_source->entry = entry;
+  out_source->size = entry->size;
+  out_location->offset = entry->offset;
+  out_location->size = entry->size;
+  ifs_get_file_stamp(archive, &out_location->archive_size, &out_location->archive_mtime);
+  return 0;
+}
 
-    file_buffer = (uint8_t*) malloc(file_length);
-    fread(file_buffer, sizeof(uint8_t), file_length, file);
-    fclose(file);
+// whether the opened ifs is still the one a location was found in.
+static int is_location_current(FILE *file, const iidx_1_location *location)
+{
+#ifdef _WIN32
+  struct _stat64 st;
+  int stat_failed = _fstat64(_fileno(file), &st);
+#else
+  struct stat st;
+  int stat_failed = fstat(fileno(file), &st);
+#endif
+  return !stat_failed && (uint64_t) st.st_size == location->archive_size && (int64_t) st.st_mtime == location->archive_mtime;
+}
+
+static int open_iidx_1_file(const char *filename, sound_format format, const char *music_id, iidx_1_source *out_source,
+                            iidx_1_location *location, int *has_location)
+{
+  memset(out_source, 0, sizeof(*out_source));
+  if (format == SOUND_FORMAT_EXTRACTED)
+  {
+    *has_location = 0;
+    return open_extracted(filename, out_source);
   }
-  else
+
+  if (*has_location)
   {
-    // no extracted folder exists already, have to read the ifs.
+    // we already know where the .1 lives in the ifs, no need to decode the manifest again.
+    out_source->file = open_file(filename);
+    if (out_source->file == NULL)
+      return -1;
+    if (is_location_current(out_source->file, location))
+    {
+      out_source->fd = fileno(out_source->file);
+      out_source->base = location->offset;
+      out_source->size = location->size;
+      return 0;
+    }
+
+    // the archive was replaced since, its manifest has to be read again.
+    fclose(out_source->file);
+    out_source->file = NULL;
+  }
+
+  if (open_ifs(filename, music_id, out_source, location))
+    return -1;
+  *has_location = 1;
+  return 0;
+}
+
+static int open_iidx_1(const char *music_id, iidx_1_source *out_source, iidx_1_location *location, int *has_location)
+{
+  memset(out_source, 0, sizeof(*out_source));
+
+  // with an index we know exactly which file to open, without one we probe data/sound.
+  char filename[512];
+  sound_format format = SOUND_FORMAT_IFS;
+  int resolved = resolve_song(music_id, filename, sizeof(filename), &format);
+  if (resolved < 0)
+    return -1;
+
+  if (!resolved)
+  {
+    // check if .1 file already exists, otherwise have to read the ifs. a known location means it's in the ifs.
+    snprintf(filename, sizeof(filename), "data/sound/%s/%s.1", music_id, music_id);
+    if (!*has_location && open_extracted(filename, out_source) == 0)
+      return 0;
     snprintf(filename, sizeof(filename), "data/sound/%s.ifs", music_id);
+    format = SOUND_FORMAT_IFS;
+  }
 
-    // get the manifest of the ifs file.
-    mxml_node_t *manifest = NULL;
-    uint32_t manifest_end = 0;
-    ifs_error e = ifs_extract_manifest(filename, &manifest, &manifest_end);
-    if (e != IFS_NO_ERROR)
-      return e;
-
-    // get the text of our .1 file and parse it.
-    char manifest_path[128];
-    snprintf(manifest_path, sizeof(manifest_path), "imgfs/_%s/_%s_E1", music_id, music_id);
-    const char *iidx_1_manifest = mxmlGetText(mxmlFindPath(manifest, manifest_path), NULL);
-    char *endptr = NULL;
-    int file_offset = strtol(iidx_1_manifest, &endptr, 10);
-    file_length = strtol(endptr, NULL, 10);
-    int iidx_1_offset = manifest_end + file_offset;
-    mxmlDelete(manifest);
-
-    // read the iidx_1 file from the ifs.
-    file = fopen(filename, "rb");
-    if (file == NULL)
-      return -1;
-    file_buffer = (uint8_t*) malloc(file_length);
-    fseek(file, iidx_1_offset, SEEK_SET);
-    fread(file_buffer, sizeof(uint8_t), file_length, file);
-    fclose(file);
+  return open_iidx_1_file(filename, format, music_id, out_source, location, has_location);
+}
+
+static int read_iidx_1_range(const iidx_1_source *source, uint32_t offset, void *out, uint32_t size)
+{
+  if (offset > source->size || size > source->size - offset)
+    return -1;
+
+  TRACE_BEGIN_VALUE("file_read", size);
+  int ret;
+  if (source->archive != NULL)
+    ret = ifs_read_entry(source->archive, source->entry, offset, out, size) == IFS_NO_ERROR ? 0 : -1;
+  else
+    ret = file_read_at(source->fd, source->base + offset, out, size);
+  TRACE_END("file_read");
+
+  return ret;
+}
+
+static void read_ahead_range(const iidx_1_source *source, uint32_t offset, uint32_t size)
+{
+  if (source->archive != NULL)
+  {
+    ifs_will_need_entry(source->archive, source->entry, offset, size);
+    return;
+  }
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+  posix_fadvise(source->fd, (off_t) (source->base + offset), (off_t) size, POSIX_FADV_WILLNEED);
+#else
+  (void) offset;
+  (void) size;
+#endif
+}
+
+static int scan_iidx_1(const iidx_1_source *source, iidx_1_note_counts *out_note_counts)
+{
+  // only the header and one small buffer are ever in memory, however big the charts are.
+  uint8_t header[IIDX_1_HEADER_SIZE];
+  if (read_iidx_1_range(source, 0, header, sizeof(header)))
+    return -1;
+
+  uint8_t buffer[STREAM_BUFFER_SIZE];
+  iidx_1_note_counts note_counts;
+  for (int i = 0; i < IIDX_1_MAX_CHART_COUNT; ++i)
+  {
+    uint32_t offset, length;
+    if (iidx_1_get_chart_range(header, source->size, (iidx_1_chart) i, &offset, &length) || (length & 0x07))
+    {
+      note_counts.charts[i] = -1;
+      continue;
+    }
+
+    read_ahead_range(source, offset, length);
+    int note_count = 0;
+    int end = 0;
+    for (uint32_t scanned = 0; scanned < length && !end && note_count >= 0;)
+    {
+      uint32_t size = length - scanned < sizeof(buffer) ? length - scanned : (uint32_t) sizeof(buffer);
+      if (read_iidx_1_range(source, offset + scanned, buffer, size))
+        note_count = -1;
+      else
+        note_count += iidx_1_count_event_notes(buffer, size, &end);
+      scanned += size;
+    }
+    note_counts.charts[i] = note_count;
+  }
+
+  *out_note_counts = note_counts;
+  return 0;
+}
+
+static void close_iidx_1(iidx_1_source *source)
+{
+  if (source->file != NULL)
+    fclose(source->file);
+  ifs_close(source->archive);
+}
+
+int get_music_note_counts_streaming(const char *music_id, iidx_1_note_counts *out_note_counts)
+{
+  if (music_id == NULL || out_note_counts == NULL)
+    return -1;
+
+  iidx_1_location location;
+  int has_location = 0;
+  iidx_1_source source;
+  int ret = open_iidx_1(music_id, &source, &location, &has_location) == 0 ? scan_iidx_1(&source, out_note_counts) : -1;
+  close_iidx_1(&source);
+  return ret;
+}
+
+int get_note_counts_from_fd(int fd, uint64_t offset, uint32_t length, iidx_1_note_counts *out_note_counts)
+{
+  if (fd < 0 || out_note_counts == NULL)
+    return -1;
+
+  iidx_1_source source;
+  memset(&source, 0, sizeof(source));
+  source.fd = fd;
+  source.base = offset;
+  source.size = length;
+  return scan_iidx_1(&source, out_note_counts);
+}
+
+static int read_iidx_1(const char *music_id, uint8_t **out_file_buffer, uint32_t *out_file_length,
+                       iidx_1_location *location, int *has_location)
+{
+  iidx_1_source source;
+  if (open_iidx_1(music_id, &source, location, has_location))
+  {
+    close_iidx_1(&source);
+    return -1;
+  }
+
+  allocator_stage previous_stage = allocator_set_stage(ALLOCATOR_STAGE_CHART);
+  uint8_t *file_buffer = (uint8_t*) allocator_malloc(source.size ? source.size : 1);
+  allocator_set_stage(previous_stage);
+  if (file_buffer == NULL || read_iidx_1_range(&source, 0, file_buffer, source.size))
+  {
+    allocator_free(file_buffer);
+    close_iidx_1(&source);
+    return -1;
   }
+  close_iidx_1(&source);
 
   *out_file_buffer = file_buffer;
-  *out_file_length = file_length;
+  *out_file_length = source.size;
   return 0;
 }
 
-int get_chart_note_count(const char *music_id, iidx_1_chart chart)
+int load_iidx_1(const char *music_id, uint8_t **out_file_buffer, uint32_t *out_file_length)
 {
-  if (music_id == NULL || (uint32_t)chart >= IIDX_1_MAX_CHART_COUNT)
+  if (music_id == NULL || out_file_buffer == NULL || out_file_length == NULL)
     return -1;
 
-  // read the iidx_1 file.
+  iidx_1_location location;
+  int has_location = 0;
+  return read_iidx_1(music_id, out_file_buffer, out_file_length, &location, &has_location);
+}
+
+static void destroy_index(void *index)
+{
+  sound_index_destroy((sound_index*) index);
+}
+
+int set_music_roots(const char **roots, uint32_t root_count)
+{
+  sound_index *index = NULL;
+  if (root_count > 0)
+  {
+    allocator_stage previous_stage = allocator_set_stage(ALLOCATOR_STAGE_INDEX);
+    index = sound_index_create(roots, root_count);
+    allocator_set_stage(previous_stage);
+    if (index == NULL)
+      return -1;
+  }
+
+  epoch_retired *retired = (epoch_retired*) allocator_malloc(sizeof(epoch_retired));
+  if (retired == NULL)
+  {
+    sound_index_destroy(index);
+    return -1;
+  }
+
+  mutex_lock(&roots_mutex);
+  sound_index *old_index = atomic_exchange(&roots_index, index);
+  if (old_index != NULL)
+    epoch_retire(&retired_indexes, retired, old_index, destroy_index);
+  else
+    allocator_free(retired);
+  epoch_reclaim(&retired_indexes);
+  mutex_unlock(&roots_mutex);
+
+  // cached songs may have come from a different root.
+  iidx_1_cache_clear();
+  return 0;
+}
+
+static iidx_1_cached_buffer *acquire_iidx_1(const char *music_id)
+{
+  // serve repeated queries for the same song from the cache when it's enabled.
+  iidx_1_location location;
+  int has_location = 0;
+  iidx_1_cached_buffer *buffer = iidx_1_cache_acquire(music_id, &location, &has_location);
+  if (buffer != NULL)
+    return buffer;
+
   uint8_t *file_buffer = NULL;
   uint32_t file_length = 0;
-  if (load_iidx_1(music_id, &file_buffer, &file_length))
+  if (read_iidx_1(music_id, &file_buffer, &file_length, &location, &has_location))
+    return NULL;
+
+  return iidx_1_cache_insert(music_id, file_buffer, file_length, has_location ? &location : NULL);
+}
+
+int set_iidx_1_cache_budget(size_t budget)
+{
+  return iidx_1_cache_set_budget(budget);
+}
+
+void clear_iidx_1_cache(void)
+{
+  iidx_1_cache_clear();
+}
+
+int get_chart_note_count(const char *music_id, iidx_1_chart chart)
+{
+  if (music_id == NULL || (uint32_t)chart >= IIDX_1_MAX_CHART_COUNT)
     return -1;
 
-  // get the note counts from the file.
-  int ret = iidx_1_get_note_count(file_buffer, file_length, chart);
+  // count from the cached file if we have it.
+  iidx_1_location location;
+  int has_location = 0;
+  iidx_1_cached_buffer *buffer = iidx_1_cache_acquire(music_id, &location, &has_location);
+  if (buffer != NULL)
+  {
+    int ret = iidx_1_get_note_count(buffer->data, buffer->length, chart);
+    iidx_1_cache_release(buffer);
+    return ret;
+  }
 
-  free(file_buffer);
+  // otherwise only read the header and the one chart instead of the whole file.
+  iidx_1_source source;
+  if (open_iidx_1(music_id, &source, &location, &has_location))
+  {
+    close_iidx_1(&source);
+    return -1;
+  }
+
+  int ret = -1;
+  uint8_t header[IIDX_1_HEADER_SIZE];
+  uint32_t offset, length;
+  if (read_iidx_1_range(&source, 0, header, sizeof(header)) == 0 &&
+      iidx_1_get_chart_range(header, source.size, chart, &offset, &length) == 0)
+  {
+    allocator_stage previous_stage = allocator_set_stage(ALLOCATOR_STAGE_CHART);
+    uint8_t *chart_data = (uint8_t*) allocator_malloc(length ? length : 1);
+    allocator_set_stage(previous_stage);
+    if (chart_data != NULL && read_iidx_1_range(&source, offset, chart_data, length) == 0)
+      ret = iidx_1_get_chart_note_count(chart_data, length);
+    allocator_free(chart_data);
+  }
+
+  // keep the location so the song's next chart doesn't decode the manifest again.
+  if (source.archive != NULL && has_location)
+    iidx_1_cache_insert_location(music_id, &location);
+
+  close_iidx_1(&source);
   return ret;
 }
 
@@ -85,14 +458,334 @@ int get_music_note_counts(const char *music_id, iidx_1_note_counts *out_note_cou
     return -1;
 
   // read the iidx_1 file.
-  uint8_t *file_buffer = NULL;
-  uint32_t file_length = 0;
-  if (load_iidx_1(music_id, &file_buffer, &file_length))
+  iidx_1_cached_buffer *buffer = acquire_iidx_1(music_id);
+  if (buffer == NULL)
     return -1;
 
   // get the note counts from the file.
-  int ret = iidx_1_get_note_counts(file_buffer, file_length, out_note_counts);
+  int ret = iidx_1_get_note_counts(buffer->data, buffer->length, out_note_counts);
+
+  iidx_1_cache_release(buffer);
+  return ret;
+}
+
+typedef struct
+{
+  uint32_t index; // position in the caller's list.
+  char path[512];
+  sound_format format;
+  disk_position position;
+
+  // opened a few songs ahead of the one being read, either a cached buffer or the .1 on disk.
+  iidx_1_cached_buffer *buffer;
+  iidx_1_source source;
+  int is_open;
+} batch_item;
+
+static int compare_batch_items(const void *a, const void *b)
+{
+  const batch_item *item_a = (const batch_item*) a;
+  const batch_item *item_b = (const batch_item*) b;
+  if (item_a->position.device != item_b->position.device)
+    return item_a->position.device < item_b->position.device ? -1 : 1;
+  if (item_a->position.position != item_b->position.position)
+    return item_a->position.position < item_b->position.position ? -1 : 1;
+  return item_a->index < item_b->index ? -1 : item_a->index > item_b->index;
+}
+
+static int locate_iidx_1(const char *music_id, batch_item *item)
+{
+  // same lookup order as open_iidx_1, but only stats the file.
+  memset(item, 0, sizeof(*item));
+  int resolved = resolve_song(music_id, item->path, sizeof(item->path), &item->format);
+  if (resolved < 0)
+    return -1;
+  if (resolved)
+    return disk_order_get_position(item->path, &item->position);
+
+  snprintf(item->path, sizeof(item->path), "data/sound/%s/%s.1", music_id, music_id);
+  item->format = SOUND_FORMAT_EXTRACTED;
+  if (disk_order_get_position(item->path, &item->position) == 0)
+    return 0;
+  snprintf(item->path, sizeof(item->path), "data/sound/%s.ifs", music_id);
+  item->format = SOUND_FORMAT_IFS;
+  return disk_order_get_position(item->path, &item->position);
+}
+
+static void open_batch_item(const char *music_id, batch_item *item)
+{
+  // opening an ifs decodes its manifest, so from here on we know the .1's exact range and can have the os read it
+  // while the songs before it are being counted.
+  iidx_1_location location;
+  int has_location = 0;
+  item->buffer = iidx_1_cache_acquire(music_id, &location, &has_location);
+  if (item->buffer != NULL)
+  {
+    item->is_open = 1;
+    return;
+  }
+
+  if (open_iidx_1_file(item->path, item->format, music_id, &item->source, &location, &has_location))
+  {
+    close_iidx_1(&item->source);
+    return;
+  }
+  if (item->source.archive != NULL && has_location)
+    iidx_1_cache_insert_location(music_id, &location);
+
+  read_ahead_range(&item->source, 0, item->source.size);
+  item->is_open = 1;
+}
+
+static int read_batch_item(batch_item *item, iidx_1_note_counts *out_note_counts)
+{
+  if (!item->is_open)
+    return -1;
+
+  int ret;
+  if (item->buffer != NULL)
+  {
+    ret = iidx_1_get_note_counts(item->buffer->data, item->buffer->length, out_note_counts);
+    iidx_1_cache_release(item->buffer);
+  }
+  else
+  {
+    ret = scan_iidx_1(&item->source, out_note_counts);
+    close_iidx_1(&item->source);
+  }
+
+  item->is_open = 0;
+  return ret;
+}
+
+int get_music_note_counts_batch(const char **music_ids, uint32_t count, iidx_1_note_counts *out_note_counts)
+{
+  if ((music_ids == NULL || out_note_counts == NULL) && count > 0)
+    return -1;
+
+  allocator_stage previous_stage = allocator_set_stage(ALLOCATOR_STAGE_SCAN);
+  batch_item *items = (batch_item*) allocator_malloc((count ? count : 1) * sizeof(batch_item));
+  allocator_set_stage(previous_stage);
+  if (items == NULL)
+    return -1;
+
+  // find every song on disk first, songs that can't be found fail straight away.
+  int failures = 0;
+  uint32_t item_count = 0;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    memset(&out_note_counts[i], 0xff, sizeof(iidx_1_note_counts));
+    if (music_ids[i] == NULL || locate_iidx_1(music_ids[i], &items[item_count]))
+    {
+      ++failures;
+      continue;
+    }
+    items[item_count++].index = i;
+  }
+
+  // then read them in the order they sit on disk, with the next few already open and being read ahead.
+  TRACE_BEGIN_VALUE("batch_sort", item_count);
+  qsort(items, item_count, sizeof(batch_item), compare_batch_items);
+  TRACE_END("batch_sort");
+
+  uint32_t opened = 0;
+  for (uint32_t i = 0; i < item_count; ++i)
+  {
+    for (; opened < item_count && opened <= i + BATCH_READ_AHEAD; ++opened)
+      open_batch_item(music_ids[items[opened].index], &items[opened]);
+
+    uint32_t index = items[i].index;
+    if (read_batch_item(&items[i], &out_note_counts[index]))
+    {
+      memset(&out_note_counts[index], 0xff, sizeof(iidx_1_note_counts));
+      ++failures;
+    }
+  }
+
+  allocator_free(items);
+  return failures;
+}
+
+int get_music_note_counts_cached(const char *music_id, chart_cache *cache, iidx_1_note_counts *out_note_counts)
+{
+  if (music_id == NULL || out_note_counts == NULL)
+    return -1;
+
+  // read the iidx_1 file.
+  iidx_1_cached_buffer *buffer = acquire_iidx_1(music_id);
+  if (buffer == NULL)
+    return -1;
+
+  // get the note counts from the file, skipping charts the cache has already seen.
+  int ret = iidx_1_get_note_counts_cached(buffer->data, buffer->length, cache, out_note_counts);
+
+  iidx_1_cache_release(buffer);
+  return ret;
+}
+
+int get_music_note_densities(const char *music_id, uint32_t window, iidx_1_note_densities *out_densities)
+{
+  if (music_id == NULL || out_densities == NULL)
+    return -1;
+
+  // read the iidx_1 file.
+  iidx_1_cached_buffer *buffer = acquire_iidx_1(music_id);
+  if (buffer == NULL)
+    return -1;
+
+  // run the density analysis over every chart.
+  int ret = iidx_1_get_note_densities(buffer->data, buffer->length, window, out_densities);
 
-  free(file_buffer);
+  iidx_1_cache_release(buffer);
   return ret;
 }
+
+static int make_parent_directories(char *path)
+{
+  // create every directory leading up to the file, like mkdir -p.
+  for (char *cur = strchr(path, '/'); cur != NULL; cur = strchr(cur + 1, '/'))
+  {
+    *cur = 0;
+    int failed = make_directory(path) != 0 && errno != EEXIST;
+    *cur = '/';
+    if (failed)
+      return -1;
+  }
+
+  return 0;
+}
+
+static int is_safe_path_component(const char *name)
+{
+  // manifest names come from the archive, "_E_E" unescapes to ".." and would climb out of the root.
+  return name[0] != 0 && strcmp(name, ".") != 0 && strcmp(name, "..") != 0 && strchr(name, '/') == NULL &&
+    strchr(name, '\\') == NULL;
+}
+
+static int extract_music_ifs(const char *music_id, int charts_only)
+{
+  // the song is extracted next to its ifs, in whichever root the index picked for it.
+  char filename[512];
+  sound_format format = SOUND_FORMAT_IFS;
+  int resolved = resolve_song(music_id, filename, sizeof(filename), &format);
+  if (resolved < 0)
+    return -1;
+  if (!resolved)
+    snprintf(filename, sizeof(filename), "data/sound/%s.ifs", music_id);
+  else if (format == SOUND_FORMAT_EXTRACTED)
+    return 0;
+
+  // <root>/<id>.ifs -> <root>.
+  int root_length = (int) (strlen(filename) - strlen(music_id) - strlen("/.ifs"));
+
+  ifs_archive *archive = NULL;
+  if (ifs_open(filename, &archive) != IFS_NO_ERROR)
+    return -1;
+
+  int ret = 0;
+  for (uint32_t i = 0; i < ifs_get_entry_count(archive) && ret == 0; ++i)
+  {
+    const ifs_entry *entry = ifs_get_entry(archive, i);
+
+    // the charts are the _E1 entries.
+    size_t path_length = strlen(entry->path);
+    if (charts_only && (path_length < 3 || strcmp(entry->path + path_length - 3, "_E1") != 0))
+      continue;
+
+    // build the output path, skipping the manifest's root node ("imgfs").
+    char out_path[512];
+    int out_length = snprintf(out_path, sizeof(out_path), "%.*s", root_length, filename);
+    const char *component = strchr(entry->path, '/');
+    while (component != NULL && ret == 0)
+    {
+      ++component;
+      const char *next = strchr(component, '/');
+      size_t component_length = next != NULL ? (size_t) (next - component) : strlen(component);
+
+      char name[256];
+      char unescaped[256];
+      if (component_length >= sizeof(name))
+      {
+        ret = -1;
+        break;
+      }
+      memcpy(name, component, component_length);
+      name[component_length] = 0;
+
+      int written = -1;
+      if (ifs_unescape_name(name, unescaped, sizeof(unescaped)) == 0 && is_safe_path_component(unescaped))
+        written = snprintf(out_path + out_length, sizeof(out_path) - out_length, "/%s", unescaped);
+      if (written < 0 || (size_t) written >= sizeof(out_path) - out_length)
+        ret = -1;
+      else
+        out_length += written;
+
+      component = next;
+    }
+
+    if (ret == 0 && make_parent_directories(out_path) != 0)
+      ret = -1;
+    if (ret == 0 && ifs_extract_entry(archive, entry, out_path) != IFS_NO_ERROR)
+      ret = -1;
+  }
+
+  ifs_close(archive);
+  return ret;
+}
+
+typedef struct
+{
+  const char **music_ids;
+  uint32_t count;
+  int charts_only;
+
+  atomic_uint next;
+  atomic_int failures;
+} extract_job;
+
+static thread_result THREAD_CALL extract_worker(void *arg)
+{
+  extract_job *job = (extract_job*) arg;
+
+  // every worker pulls the next song until there are none left.
+  for (;;)
+  {
+    uint32_t i = atomic_fetch_add(&job->next, 1);
+    if (i >= job->count)
+      break;
+    if (extract_music_ifs(job->music_ids[i], job->charts_only))
+      atomic_fetch_add(&job->failures, 1);
+  }
+
+  return 0;
+}
+
+int extract_music(const char **music_ids, uint32_t count, int charts_only, uint32_t thread_count)
+{
+  if (music_ids == NULL)
+    return -1;
+
+  extract_job job;
+  job.music_ids = music_ids;
+  job.count = count;
+  job.charts_only = charts_only;
+  atomic_init(&job.next, 0);
+  atomic_init(&job.failures, 0);
+
+  if (thread_count > MAX_EXTRACT_THREADS)
+    thread_count = MAX_EXTRACT_THREADS;
+  if (thread_count > count)
+    thread_count = count;
+
+  // the calling thread works too, so only spawn the extra ones.
+  thread threads[MAX_EXTRACT_THREADS];
+  uint32_t started = 0;
+  while (started + 1 < thread_count && thread_create(&threads[started], extract_worker, &job) == 0)
+    ++started;
+
+  extract_worker(&job);
+  for (uint32_t i = 0; i < started; ++i)
+    thread_join(threads[i]);
+
+  return atomic_load(&job.failures);
+}
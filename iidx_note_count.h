@@ -5,11 +5,64 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
+
 #include "iidx_1.h"
 
+// every function here is reentrant and may be called from any number of threads at once. queries only share
+// the .1 buffer cache, which is locked internally. objects passed in by the caller (e.g. a chart_cache) are not
+// locked, give every thread its own or serialise access to them.
+
+#define IIDX_MUSIC_ID_SIZE 16
+
+// note counts of a single song, keyed by its music id (e.g. "01000").
+typedef struct
+{
+  char music_id[IIDX_MUSIC_ID_SIZE];
+  iidx_1_note_counts note_counts;
+} iidx_music_note_counts;
+
+// indexes the songs of every root once (e.g. {"patch/sound", "data/sound"}), earlier roots win over later ones and an
+// extracted folder wins over the ifs. from then on every query opens exactly the file the index points at, songs
+// that aren't in the index fail without touching the disk. call again to pick up new songs, 0 roots goes back to
+// looking in data/sound. queries read the index without locking, it can be replaced while they run.
+int set_music_roots(const char **roots, uint32_t root_count);
+
+// reads the .1 file of a song, either extracted or from its ifs. the buffer must be released with allocator_free().
+// free() only works with the default allocator hooks, see allocator.h.
+int load_iidx_1(const char *music_id, uint8_t **out_file_buffer, uint32_t *out_file_length);
+
+// caches loaded .1 files in memory, up to budget bytes, evicting the least recently used songs first.
+// 0 disables the cache (the default). cached songs aren't reloaded if their files change, clear the cache to pick changes up.
+int set_iidx_1_cache_budget(size_t budget);
+void clear_iidx_1_cache(void);
+
 int get_chart_note_count(const char *music_id, iidx_1_chart chart);
 int get_music_note_counts(const char *music_id, iidx_1_note_counts *out_note_counts);
 
+// same as get_music_note_counts, but reads the charts through a small fixed-size buffer instead of loading the whole
+// file, so memory use stays constant however big the file is. doesn't use the .1 cache.
+int get_music_note_counts_streaming(const char *music_id, iidx_1_note_counts *out_note_counts);
+// streaming scan of a .1 that lives length bytes at offset in an open file, e.g. an extracted .1 at 0 or a payload
+// inside an ifs. fd is only read with positional reads, its file position isn't changed.
+int get_note_counts_from_fd(int fd, uint64_t offset, uint32_t length, iidx_1_note_counts *out_note_counts);
+
+// looks up many songs at once, reading them in the order they are stored on disk rather than the order given, with
+// read ahead hints for the next few. meant for cold lookups on spinning disks. results are written in the order of
+// music_ids, songs that fail have every chart set to -1. returns the number of songs that failed.
+int get_music_note_counts_batch(const char **music_ids, uint32_t count, iidx_1_note_counts *out_note_counts);
+
+// cache may be shared across songs/versions so byte-identical charts are only scanned once.
+int get_music_note_counts_cached(const char *music_id, chart_cache *cache, iidx_1_note_counts *out_note_counts);
+
+int get_music_note_densities(const char *music_id, uint32_t window, iidx_1_note_densities *out_densities);
+
+// extracts each song's ifs into the <root>/<id>/ layout (or just the <id>.1 charts) across thread_count threads.
+// the root is the one set_music_roots found the ifs in (data/sound without roots), songs it already found extracted
+// are skipped. the index isn't updated, call set_music_roots again to pick up the extracted songs.
+// returns the number of songs that failed to extract.
+int extract_music(const char **music_ids, uint32_t count, int charts_only, uint32_t thread_count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,5 +1,6 @@
 #include "kbinxml.h"
 
+#include "allocator.h"
 #include "binary_stream.h"
 
 #define SIGNATURE 0xA0
@@ -14,7 +15,7 @@ typedef struct
   char type;
 } xml_format;
 
-static xml_format xml_formats[] = {
+static const xml_format xml_formats[] = {
   {NULL},
   {"void"},
   {"s8",  1,  'b'},
@@ -102,7 +103,7 @@ static char *unpack_sixbit(binary_stream *stream)
   uint32_t length = bs_read_u8(stream);
   
   // allocate an array for the decoded characters.
-  char *ret = (char*) calloc(length + 1, sizeof(char));
+  char *ret = (char*) allocator_calloc(length + 1, sizeof(char));
   char *ret_ptr = ret;
 
   // read in 24 bits at a time, matching up to exactly 4 encoded chars.
@@ -199,7 +200,7 @@ static char *read_and_format_data(binary_stream *data_bs, const xml_format *form
   }
 
   // allocate our text buffer.  
-  char *ret = (char*) calloc(char_per_element * total_count + 1, sizeof(char));
+  char *ret = (char*) allocator_calloc(char_per_element * total_count + 1, sizeof(char));
 
   // figure out how to format it.
   if (format == &xml_formats[XML_TYPE_STRING])
@@ -235,7 +236,7 @@ static char *read_and_format_data(binary_stream *data_bs, const xml_format *form
     // signed short.
     char *cur = ret;
     while (total_count--)
-      cur += sprintf(cur, "%hd ", bs_read_u16(data_bs));
+      cur += sprintf(cur, "%hd ", (int16_t) bs_read_u16_be(data_bs));
     *(cur - 1) = 0;
   }
   else if (format->type == 'H')
@@ -243,7 +244,7 @@ static char *read_and_format_data(binary_stream *data_bs, const xml_format *form
     // unsigned short.
     char *cur = ret;
     while (total_count--)
-      cur += sprintf(cur, "%hu ", bs_read_u16(data_bs));
+      cur += sprintf(cur, "%hu ", bs_read_u16_be(data_bs));
     *(cur - 1) = 0;
   }
   else if (format->type == 'i')
@@ -251,7 +252,7 @@ static char *read_and_format_data(binary_stream *data_bs, const xml_format *form
     // signed int.
     char *cur = ret;
     while (total_count--)
-      cur += sprintf(cur, "%d ", bs_read_u32(data_bs));
+      cur += sprintf(cur, "%d ", (int32_t) bs_read_u32_be(data_bs));
     *(cur - 1) = 0;
   }
   else if (format->type == 'I')
@@ -259,7 +260,7 @@ static char *read_and_format_data(binary_stream *data_bs, const xml_format *form
     // unsigned int.
     char *cur = ret;
     while (total_count--)
-      cur += sprintf(cur, "%u ", bs_read_u32(data_bs));
+      cur += sprintf(cur, "%u ", bs_read_u32_be(data_bs));
     *(cur - 1) = 0;
   }
   else if (format->type == 'q')
@@ -267,7 +268,7 @@ static char *read_and_format_data(binary_stream *data_bs, const xml_format *form
     // signed quad int.
     char *cur = ret;
     while (total_count--)
-      cur += sprintf(cur, "%lld ", bs_read_u64(data_bs));
+      cur += sprintf(cur, "%lld ", (long long) bs_read_u64_be(data_bs));
     *(cur - 1) = 0;
   }
   else if (format->type == 'Q')
@@ -275,7 +276,7 @@ static char *read_and_format_data(binary_stream *data_bs, const xml_format *form
     // unsigned quad int.
     char *cur = ret;
     while (total_count--)
-      cur += sprintf(cur, "%llu ", bs_read_u64(data_bs));
+      cur += sprintf(cur, "%llu ", (unsigned long long) bs_read_u64_be(data_bs));
     *(cur - 1) = 0;
   }
   else if (format->type == 'f')
@@ -283,7 +284,7 @@ static char *read_and_format_data(binary_stream *data_bs, const xml_format *form
     // float.
     char *cur = ret;
     while (total_count--)
-      cur += sprintf(cur, "%.6f ", bs_read_f32(data_bs));
+      cur += sprintf(cur, "%.6f ", bs_read_f32_be(data_bs));
     *(cur - 1) = 0;
   }
   else if (format->type == 'd')
@@ -291,7 +292,7 @@ static char *read_and_format_data(binary_stream *data_bs, const xml_format *form
     // double.
     char *cur = ret;
     while (total_count--)
-      cur += sprintf(cur, "%.6f ", bs_read_f64(data_bs));
+      cur += sprintf(cur, "%.6f ", bs_read_f64_be(data_bs));
     *(cur - 1) = 0;
   }
   else if (format->type == 'P')
@@ -312,7 +313,7 @@ mxml_node_t *kbinxml_from_binary(uint8_t *binary, uint32_t binary_length)
 
   // create a binary stream from our parameters.
   binary_stream *bs = bs_open(binary, binary_length);
-  bs_set_endianness(bs, BIG_ENDIAN);
+  bs_set_endianness(bs, BS_BIG_ENDIAN);
 
   // read the header from our stream.
   kbinxml_header header;
@@ -320,12 +321,12 @@ mxml_node_t *kbinxml_from_binary(uint8_t *binary, uint32_t binary_length)
   header.compressed = bs_read_u8(bs);
   header.encoding_key = bs_read_u8(bs);
   header.not_encoding_key = bs_read_u8(bs);
-  header.section_length = bs_read_u32(bs);
+  header.section_length = bs_read_u32_be(bs);
 
   // open another binary stream at the data section after the node.
   binary_stream *data_bs = bs_duplicate(bs);
   bs_set_offset(data_bs, header.section_length + sizeof(kbinxml_header));
-  uint32_t data_size = bs_read_u32(data_bs);
+  uint32_t data_size = bs_read_u32_be(data_bs);
 
   // verify the header is valid.
   if (header.signature == SIGNATURE &&
@@ -370,7 +371,7 @@ mxml_node_t *kbinxml_from_binary(uint8_t *binary, uint32_t binary_length)
         ret = NULL;
         goto end;
       }
-      xml_format *node_format = &xml_formats[xml_type];
+      const xml_format *node_format = &xml_formats[xml_type];
       
       // read the node name.
       char *name = NULL;
@@ -379,7 +380,7 @@ mxml_node_t *kbinxml_from_binary(uint8_t *binary, uint32_t binary_length)
       else
       {
         uint8_t length = (bs_read_u8(bs) & ~0x40);
-        name = (char*) calloc(length + 1, sizeof(char));
+        name = (char*) allocator_calloc(length + 1, sizeof(char));
         bs_read_bytes(bs, name, length);
       }
 
@@ -387,19 +388,19 @@ mxml_node_t *kbinxml_from_binary(uint8_t *binary, uint32_t binary_length)
       if (xml_type == XML_TYPE_ATTR)
       {
         // read the attribute data.
-        uint32_t length = bs_read_u32(bs);
-        char *attr_value = (char*) calloc(length + 1, sizeof(char));
+        uint32_t length = bs_read_u32_be(bs);
+        char *attr_value = (char*) allocator_calloc(length + 1, sizeof(char));
         bs_read_bytes(bs, attr_value, length);
         bs_realign32(bs);
         mxmlElementSetAttr(node, name, attr_value);
-        free(attr_value);
-        free(name);
+        allocator_free(attr_value);
+        allocator_free(name);
       }
       else
       {
         // make a new element.
         node = mxmlNewElement(node, name);
-        free(name);
+        allocator_free(name);
         name = NULL;
         if (xml_type == XML_TYPE_NODE_START)
           continue;
@@ -408,14 +409,14 @@ mxml_node_t *kbinxml_from_binary(uint8_t *binary, uint32_t binary_length)
         mxmlElementSetAttr(node, "__type", node_format->name);
 
         // get the total number of elements for the node's text.
-        uint32_t var_count = node_format->count == -1 ? bs_read_u32(data_bs) : node_format->count;
-        uint32_t array_count = is_array ? bs_read_u32(data_bs) : 1;
+        uint32_t var_count = node_format->count == -1 ? bs_read_u32_be(data_bs) : node_format->count;
+        uint32_t array_count = is_array ? bs_read_u32_be(data_bs) : 1;
         uint32_t total_count = var_count * array_count;
 
         // set the array node's count attribute.
         if (is_array)
         {
-          array_count = bs_read_u32(data_bs);
+          array_count = bs_read_u32_be(data_bs);
           char num_buffer[16];
           sprintf(num_buffer, "%d", array_count);
           mxmlElementSetAttr(node, "__count", num_buffer);
@@ -432,7 +433,7 @@ mxml_node_t *kbinxml_from_binary(uint8_t *binary, uint32_t binary_length)
         // format and set the text for the node.
         char *data = read_and_format_data(data_bs, node_format, total_count);
         mxmlNewText(node, 0, data);
-        free(data);
+        allocator_free(data);
       }
     }
   }
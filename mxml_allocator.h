@@ -0,0 +1,24 @@
+#ifndef MXML_ALLOCATOR_H_
+#define MXML_ALLOCATOR_H_
+
+// force-included into every mxml source by CMakeLists.txt, so the vendored library allocates through the allocator
+// hooks without being patched. the system headers come first: their include guards keep the macros below out of
+// their declarations when mxml includes them again.
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+
+#define malloc(size) allocator_malloc(size)
+#define calloc(count, size) allocator_calloc(count, size)
+#define realloc(ptr, size) allocator_realloc(ptr, size)
+#define free(ptr) allocator_free(ptr)
+#undef strdup
+#define strdup(s) allocator_strdup(s)
+
+#endif // MXML_ALLOCATOR_H_
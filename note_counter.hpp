@@ -0,0 +1,493 @@
+/*
+  Optional header-only C++17/20 layer over the C api.
+  Everything here is a thin view or owning handle around the C types, nothing is copied or allocated
+  beyond what the C functions already do.
+ */
+#ifndef NOTE_COUNTER_HPP_
+#define NOTE_COUNTER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+  #include <span>
+  #define NOTE_COUNTER_HAS_STD_SPAN 1
+#endif
+
+#include "allocator.h"
+#include "iidx_1.h"
+#include "iidx_note_count.h"
+#include "ifs.h"
+#include "kbinxml.h"
+
+namespace note_counter
+{
+
+#ifdef NOTE_COUNTER_HAS_STD_SPAN
+template <class T>
+using span = std::span<T>;
+#else
+// minimal stand-in for std::span when building as C++17.
+template <class T>
+class span
+{
+public:
+  constexpr span() noexcept = default;
+  constexpr span(T *data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+  constexpr T *data() const noexcept { return data_; }
+  constexpr std::size_t size() const noexcept { return size_; }
+  constexpr bool empty() const noexcept { return size_ == 0; }
+  constexpr T *begin() const noexcept { return data_; }
+  constexpr T *end() const noexcept { return data_ + size_; }
+  constexpr T &operator[](std::size_t i) const noexcept { return data_[i]; }
+  constexpr span subspan(std::size_t offset, std::size_t count) const noexcept { return span(data_ + offset, count); }
+
+private:
+  T *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+#endif
+
+inline constexpr std::uint32_t chart_end_signature = 0x7fffffff;
+inline constexpr std::size_t event_size = 8;
+
+// a single decoded .1 event.
+struct event
+{
+  std::uint32_t offset;
+  std::uint8_t type;
+  std::uint8_t param;
+  std::uint16_t value;
+
+  // 0x00 == 1p note, 0x01 == 2p note.
+  constexpr bool is_note() const noexcept { return type == 0x00 || type == 0x01; }
+  constexpr bool is_charge_note() const noexcept { return is_note() && value > 0; }
+  constexpr bool is_end() const noexcept { return offset == chart_end_signature; }
+
+  // how much the event adds to the note count (charge notes count twice).
+  constexpr int note_weight() const noexcept { return is_note() ? (value > 0 ? 2 : 1) : 0; }
+};
+
+// decodes 8 little endian bytes, compilers fold this into plain loads.
+constexpr event decode_event(const std::uint8_t *p) noexcept
+{
+  return event{
+    static_cast<std::uint32_t>(p[0]) | (static_cast<std::uint32_t>(p[1]) << 8) |
+      (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24),
+    p[4],
+    p[5],
+    static_cast<std::uint16_t>(p[6] | (p[7] << 8))
+  };
+}
+
+// marks the end of an event range, either the end of the bytes or the end of chart signature.
+struct event_sentinel {};
+
+// events are decoded on the fly and returned by value, so as a legacy iterator this is only an input iterator.
+// c++20 ranges don't need a real reference, there it's a forward iterator.
+class event_iterator
+{
+public:
+  using iterator_category = std::input_iterator_tag;
+#if __cplusplus >= 202002L
+  using iterator_concept = std::forward_iterator_tag;
+#endif
+  using value_type = event;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const event*;
+  using reference = event;
+
+  constexpr event_iterator() noexcept = default;
+  constexpr event_iterator(const std::uint8_t *cur, const std::uint8_t *end) noexcept : cur_(cur), end_(end) {}
+
+  constexpr event operator*() const noexcept { return decode_event(cur_); }
+  constexpr event_iterator &operator++() noexcept { cur_ += event_size; return *this; }
+  constexpr event_iterator operator++(int) noexcept { event_iterator ret = *this; ++*this; return ret; }
+
+  constexpr bool operator==(const event_iterator &other) const noexcept { return cur_ == other.cur_; }
+  constexpr bool operator!=(const event_iterator &other) const noexcept { return cur_ != other.cur_; }
+
+  constexpr bool at_end() const noexcept
+  {
+    return static_cast<std::size_t>(end_ - cur_) < event_size || decode_event(cur_).is_end();
+  }
+  friend constexpr bool operator==(const event_iterator &it, event_sentinel) noexcept { return it.at_end(); }
+  friend constexpr bool operator!=(const event_iterator &it, event_sentinel) noexcept { return !it.at_end(); }
+  friend constexpr bool operator==(event_sentinel, const event_iterator &it) noexcept { return it.at_end(); }
+  friend constexpr bool operator!=(event_sentinel, const event_iterator &it) noexcept { return !it.at_end(); }
+
+private:
+  const std::uint8_t *cur_ = nullptr;
+  const std::uint8_t *end_ = nullptr;
+};
+
+// view over a single chart's events, stops at the end of chart signature.
+// like the C api a chart whose length isn't a multiple of the event size is invalid, and so is a default constructed
+// view (what iidx_1_view returns for charts that don't exist). invalid charts have no events and a note count of -1.
+class chart_view
+{
+public:
+  constexpr chart_view() noexcept = default;
+  constexpr explicit chart_view(span<const std::uint8_t> bytes) noexcept
+    : bytes_(bytes), valid_(bytes.size() % event_size == 0) {}
+
+  constexpr span<const std::uint8_t> bytes() const noexcept { return bytes_; }
+  constexpr bool valid() const noexcept { return valid_; }
+  constexpr bool empty() const noexcept { return !valid_ || bytes_.size() < event_size; }
+
+  constexpr event_iterator begin() const noexcept
+  {
+    return valid_ ? event_iterator(bytes_.data(), bytes_.data() + bytes_.size()) : event_iterator();
+  }
+  constexpr event_sentinel end() const noexcept { return {}; }
+
+  constexpr int note_count() const noexcept
+  {
+    if (!valid_)
+      return -1;
+
+    int ret = 0;
+    for (event e : *this)
+      ret += e.note_weight();
+    return ret;
+  }
+
+private:
+  span<const std::uint8_t> bytes_;
+  bool valid_ = false;
+};
+
+// view over a whole .1 file.
+class iidx_1_view
+{
+public:
+  static constexpr std::size_t header_size = IIDX_1_MAX_CHART_COUNT * 2 * sizeof(std::uint32_t);
+
+  constexpr iidx_1_view() noexcept = default;
+  constexpr explicit iidx_1_view(span<const std::uint8_t> file) noexcept : file_(file) {}
+
+  constexpr span<const std::uint8_t> bytes() const noexcept { return file_; }
+  constexpr bool valid() const noexcept { return file_.size() >= header_size; }
+
+  // returns an invalid view for invalid slots or out of range byte ranges.
+  constexpr chart_view chart(iidx_1_chart slot) const noexcept
+  {
+    std::size_t index = static_cast<std::size_t>(slot);
+    if (!valid() || index >= IIDX_1_MAX_CHART_COUNT)
+      return chart_view();
+
+    std::uint32_t offset = read_u32(index * 8);
+    std::uint32_t length = read_u32(index * 8 + 4);
+    if (offset > file_.size() || length > file_.size() - offset)
+      return chart_view();
+    return chart_view(file_.subspan(offset, length));
+  }
+
+  // charts that fail are -1, the same as iidx_1_get_note_counts. every chart fails if the file is too short.
+  iidx_1_note_counts note_counts() const noexcept
+  {
+    iidx_1_note_counts ret;
+    for (int i = 0; i < IIDX_1_MAX_CHART_COUNT; ++i)
+      ret.charts[i] = chart(static_cast<iidx_1_chart>(i)).note_count();
+    return ret;
+  }
+
+private:
+  constexpr std::uint32_t read_u32(std::size_t at) const noexcept
+  {
+    return static_cast<std::uint32_t>(file_[at]) | (static_cast<std::uint32_t>(file_[at + 1]) << 8) |
+      (static_cast<std::uint32_t>(file_[at + 2]) << 16) | (static_cast<std::uint32_t>(file_[at + 3]) << 24);
+  }
+
+  span<const std::uint8_t> file_;
+};
+
+// owning handle for a .1 file loaded by load_iidx_1.
+class iidx_1_buffer
+{
+public:
+  iidx_1_buffer() noexcept = default;
+  iidx_1_buffer(std::uint8_t *data, std::uint32_t size) noexcept : data_(data), size_(size) {}
+  ~iidx_1_buffer() { allocator_free(data_); }
+
+  iidx_1_buffer(const iidx_1_buffer&) = delete;
+  iidx_1_buffer &operator=(const iidx_1_buffer&) = delete;
+  iidx_1_buffer(iidx_1_buffer &&other) noexcept
+    : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+  iidx_1_buffer &operator=(iidx_1_buffer &&other) noexcept
+  {
+    if (this != &other)
+    {
+      allocator_free(data_);
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+  }
+
+  // returns an empty buffer on failure, the error is written to out_error when given.
+  static iidx_1_buffer load(const char *music_id, int *out_error = nullptr) noexcept
+  {
+    std::uint8_t *data = nullptr;
+    std::uint32_t size = 0;
+    int e = load_iidx_1(music_id, &data, &size);
+    if (out_error != nullptr)
+      *out_error = e;
+    return e == 0 ? iidx_1_buffer(data, size) : iidx_1_buffer();
+  }
+
+  explicit operator bool() const noexcept { return data_ != nullptr; }
+  std::uint8_t *data() const noexcept { return data_; }
+  std::uint32_t size() const noexcept { return size_; }
+  span<const std::uint8_t> bytes() const noexcept { return span<const std::uint8_t>(data_, size_); }
+  iidx_1_view view() const noexcept { return iidx_1_view(bytes()); }
+
+  std::uint8_t *release() noexcept { size_ = 0; return std::exchange(data_, nullptr); }
+
+private:
+  std::uint8_t *data_ = nullptr;
+  std::uint32_t size_ = 0;
+};
+
+// owning handle for an mxml tree, e.g. the result of kbinxml_from_binary.
+class xml_document
+{
+public:
+  xml_document() noexcept = default;
+  explicit xml_document(mxml_node_t *root) noexcept : root_(root) {}
+  ~xml_document() { if (root_ != nullptr) mxmlDelete(root_); }
+
+  xml_document(const xml_document&) = delete;
+  xml_document &operator=(const xml_document&) = delete;
+  xml_document(xml_document &&other) noexcept : root_(std::exchange(other.root_, nullptr)) {}
+  xml_document &operator=(xml_document &&other) noexcept
+  {
+    if (this != &other)
+    {
+      if (root_ != nullptr)
+        mxmlDelete(root_);
+      root_ = std::exchange(other.root_, nullptr);
+    }
+    return *this;
+  }
+
+  static xml_document from_binary(span<std::uint8_t> binary) noexcept
+  {
+    return xml_document(kbinxml_from_binary(binary.data(), static_cast<std::uint32_t>(binary.size())));
+  }
+
+  explicit operator bool() const noexcept { return root_ != nullptr; }
+  mxml_node_t *get() const noexcept { return root_; }
+  mxml_node_t *release() noexcept { return std::exchange(root_, nullptr); }
+
+private:
+  mxml_node_t *root_ = nullptr;
+};
+
+// a file inside an ifs, offset is absolute within the ifs.
+struct manifest_entry
+{
+  const char *name;
+  std::uint32_t offset;
+  std::uint32_t size;
+};
+
+// walks the manifest tree depth first, yielding every node that describes a file.
+// same as event_iterator, entries are returned by value.
+class manifest_iterator
+{
+public:
+  using iterator_category = std::input_iterator_tag;
+#if __cplusplus >= 202002L
+  using iterator_concept = std::forward_iterator_tag;
+#endif
+  using value_type = manifest_entry;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const manifest_entry*;
+  using reference = manifest_entry;
+
+  manifest_iterator() noexcept = default;
+  manifest_iterator(mxml_node_t *node, mxml_node_t *top, std::uint32_t manifest_end) noexcept
+    : node_(node), top_(top), manifest_end_(manifest_end)
+  {
+    skip_to_file();
+  }
+
+  manifest_entry operator*() const noexcept { return parse_entry(node_, manifest_end_); }
+  manifest_iterator &operator++() noexcept
+  {
+    node_ = mxmlWalkNext(node_, top_, MXML_DESCEND);
+    skip_to_file();
+    return *this;
+  }
+  manifest_iterator operator++(int) noexcept { manifest_iterator ret = *this; ++*this; return ret; }
+
+  bool operator==(const manifest_iterator &other) const noexcept { return node_ == other.node_; }
+  bool operator!=(const manifest_iterator &other) const noexcept { return node_ != other.node_; }
+
+  mxml_node_t *node() const noexcept { return node_; }
+
+  // node must have passed is_file, which guarantees it has text.
+  static manifest_entry parse_entry(mxml_node_t *node, std::uint32_t manifest_end) noexcept
+  {
+    // file nodes hold "offset size time".
+    char *endptr = nullptr;
+    std::uint32_t offset = static_cast<std::uint32_t>(std::strtoul(mxmlGetText(node, nullptr), &endptr, 10));
+    std::uint32_t size = static_cast<std::uint32_t>(std::strtoul(endptr, nullptr, 10));
+    return manifest_entry{mxmlGetElement(node), manifest_end + offset, size};
+  }
+
+  // a file node without text has no offset to read, it is skipped. ifs_manifest::open rejects such manifests.
+  static bool is_file(mxml_node_t *node) noexcept
+  {
+    return is_file_element(node) && mxmlGetText(node, nullptr) != nullptr;
+  }
+
+  static bool is_file_element(mxml_node_t *node) noexcept
+  {
+    if (node == nullptr || mxmlGetType(node) != MXML_ELEMENT)
+      return false;
+    const char *type = mxmlElementGetAttr(node, "__type");
+    return type != nullptr && std::strcmp(type, "3s32") == 0;
+  }
+
+private:
+  void skip_to_file() noexcept
+  {
+    while (node_ != nullptr && !is_file(node_))
+      node_ = mxmlWalkNext(node_, top_, MXML_DESCEND);
+  }
+
+  mxml_node_t *node_ = nullptr;
+  mxml_node_t *top_ = nullptr;
+  std::uint32_t manifest_end_ = 0;
+};
+
+// owning handle for an ifs manifest.
+class ifs_manifest
+{
+public:
+  ifs_manifest() noexcept = default;
+
+  // returns an empty manifest on failure, the error is written to out_error when given.
+  static ifs_manifest open(const char *path, ifs_error *out_error = nullptr) noexcept
+  {
+    ifs_manifest ret;
+    mxml_node_t *root = nullptr;
+    ifs_error e = ifs_extract_manifest(path, &root, &ret.manifest_end_);
+
+    // same as ifs_open, a file node without text is a broken manifest.
+    for (mxml_node_t *node = root; e == IFS_NO_ERROR && node != nullptr; node = mxmlWalkNext(node, root, MXML_DESCEND))
+    {
+      if (manifest_iterator::is_file_element(node) && mxmlGetText(node, nullptr) == nullptr)
+        e = IFS_MANIFEST_PARSE_ERROR;
+    }
+    if (e != IFS_NO_ERROR && root != nullptr)
+      mxmlDelete(root);
+    if (out_error != nullptr)
+      *out_error = e;
+    if (e == IFS_NO_ERROR)
+      ret.document_ = xml_document(root);
+    return ret;
+  }
+
+  explicit operator bool() const noexcept { return static_cast<bool>(document_); }
+  mxml_node_t *get() const noexcept { return document_.get(); }
+  std::uint32_t manifest_end() const noexcept { return manifest_end_; }
+
+  manifest_iterator begin() const noexcept
+  {
+    mxml_node_t *root = document_.get();
+    return root == nullptr ? manifest_iterator() : manifest_iterator(mxmlWalkNext(root, root, MXML_DESCEND), root, manifest_end_);
+  }
+  manifest_iterator end() const noexcept { return manifest_iterator(); }
+
+  // path is the escaped manifest path, e.g. "imgfs/_01000/_01000_E1".
+  bool find(const char *path, manifest_entry *out_entry) const noexcept
+  {
+    mxml_node_t *node = document_.get() == nullptr ? nullptr : mxmlFindPath(document_.get(), path);
+
+    // mxmlFindPath returns the text child of value nodes, step back up to the element.
+    if (node != nullptr && mxmlGetType(node) != MXML_ELEMENT)
+      node = mxmlGetParent(node);
+    if (!manifest_iterator::is_file(node))
+      return false;
+
+    *out_entry = manifest_iterator::parse_entry(node, manifest_end_);
+    return true;
+  }
+
+private:
+  xml_document document_;
+  std::uint32_t manifest_end_ = 0;
+};
+
+// owning handle for an opened ifs.
+class ifs_archive_handle
+{
+public:
+  ifs_archive_handle() noexcept = default;
+  explicit ifs_archive_handle(ifs_archive *archive) noexcept : archive_(archive) {}
+  ~ifs_archive_handle() { ifs_close(archive_); }
+
+  ifs_archive_handle(const ifs_archive_handle&) = delete;
+  ifs_archive_handle &operator=(const ifs_archive_handle&) = delete;
+  ifs_archive_handle(ifs_archive_handle &&other) noexcept : archive_(std::exchange(other.archive_, nullptr)) {}
+  ifs_archive_handle &operator=(ifs_archive_handle &&other) noexcept
+  {
+    if (this != &other)
+    {
+      ifs_close(archive_);
+      archive_ = std::exchange(other.archive_, nullptr);
+    }
+    return *this;
+  }
+
+  // returns an empty handle on failure, the error is written to out_error when given.
+  static ifs_archive_handle open(const char *path, ifs_error *out_error = nullptr) noexcept
+  {
+    ifs_archive *archive = nullptr;
+    ifs_error e = ifs_open(path, &archive);
+    if (out_error != nullptr)
+      *out_error = e;
+    return ifs_archive_handle(e == IFS_NO_ERROR ? archive : nullptr);
+  }
+
+  explicit operator bool() const noexcept { return archive_ != nullptr; }
+  ifs_archive *get() const noexcept { return archive_; }
+
+  // every file in the archive, sorted by path.
+  span<const ifs_entry> entries() const noexcept
+  {
+    std::uint32_t count = ifs_get_entry_count(archive_);
+    return count == 0 ? span<const ifs_entry>() : span<const ifs_entry>(ifs_get_entry(archive_, 0), count);
+  }
+
+  const ifs_entry *find(const char *path) const noexcept { return ifs_find_entry(archive_, path); }
+
+  // zero-copy view of an entry, empty if the archive couldn't be mapped.
+  span<const std::uint8_t> map(const ifs_entry &entry) const noexcept
+  {
+    const std::uint8_t *data = nullptr;
+    if (ifs_map_entry(archive_, &entry, &data) != IFS_NO_ERROR)
+      return span<const std::uint8_t>();
+    return span<const std::uint8_t>(data, entry.size);
+  }
+
+  ifs_error read(const ifs_entry &entry, std::uint32_t offset, span<std::uint8_t> out) const noexcept
+  {
+    return ifs_read_entry(archive_, &entry, offset, out.data(), static_cast<std::uint32_t>(out.size()));
+  }
+
+private:
+  ifs_archive *archive_ = nullptr;
+};
+
+} // namespace note_counter
+
+#endif // NOTE_COUNTER_HPP_
@@ -0,0 +1,189 @@
+#include "note_index.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+
+// one chart slot, note_counts and ids are parallel arrays sorted by note count (ties by id).
+typedef struct
+{
+  int *note_counts;
+  uint32_t *ids;
+  uint32_t count;
+} note_index_slot;
+
+struct note_index_s
+{
+  iidx_music_note_counts *songs;
+  uint32_t count;
+
+  note_index_slot slots[IIDX_1_MAX_CHART_COUNT];
+};
+
+typedef struct
+{
+  int note_count;
+  uint32_t id;
+} slot_entry;
+
+static int compare_slot_entries(const void *a, const void *b)
+{
+  const slot_entry *entry_a = (const slot_entry*) a;
+  const slot_entry *entry_b = (const slot_entry*) b;
+  if (entry_a->note_count != entry_b->note_count)
+    return entry_a->note_count < entry_b->note_count ? -1 : 1;
+  return entry_a->id < entry_b->id ? -1 : entry_a->id > entry_b->id;
+}
+
+static int build_slot(note_index_slot *slot, const iidx_music_note_counts *songs, uint32_t count, int chart,
+                      slot_entry *scratch)
+{
+  uint32_t slot_count = 0;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    if (songs[i].note_counts.charts[chart] > 0)
+    {
+      scratch[slot_count].note_count = songs[i].note_counts.charts[chart];
+      scratch[slot_count].id = i;
+      ++slot_count;
+    }
+  }
+  qsort(scratch, slot_count, sizeof(slot_entry), compare_slot_entries);
+
+  // split into columns, queries only binary search the note counts.
+  slot->note_counts = (int*) allocator_malloc((slot_count ? slot_count : 1) * sizeof(int));
+  slot->ids = (uint32_t*) allocator_malloc((slot_count ? slot_count : 1) * sizeof(uint32_t));
+  if (slot->note_counts == NULL || slot->ids == NULL)
+    return -1;
+  for (uint32_t i = 0; i < slot_count; ++i)
+  {
+    slot->note_counts[i] = scratch[i].note_count;
+    slot->ids[i] = scratch[i].id;
+  }
+  slot->count = slot_count;
+  return 0;
+}
+
+note_index *note_index_create(const iidx_music_note_counts *entries, uint32_t count)
+{
+  if (entries == NULL && count > 0)
+    return NULL;
+
+  note_index *ret = (note_index*) allocator_calloc(1, sizeof(note_index));
+  if (ret == NULL)
+    return NULL;
+
+  ret->songs = (iidx_music_note_counts*) allocator_malloc((count ? count : 1) * sizeof(iidx_music_note_counts));
+  slot_entry *scratch = (slot_entry*) allocator_malloc((count ? count : 1) * sizeof(slot_entry));
+  if (ret->songs == NULL || scratch == NULL)
+  {
+    allocator_free(scratch);
+    note_index_destroy(ret);
+    return NULL;
+  }
+  if (count > 0)
+    memcpy(ret->songs, entries, (size_t) count * sizeof(iidx_music_note_counts));
+  ret->count = count;
+
+  for (int i = 0; i < IIDX_1_MAX_CHART_COUNT; ++i)
+  {
+    if (build_slot(&ret->slots[i], ret->songs, count, i, scratch))
+    {
+      allocator_free(scratch);
+      note_index_destroy(ret);
+      return NULL;
+    }
+  }
+
+  allocator_free(scratch);
+  return ret;
+}
+
+void note_index_destroy(note_index *index)
+{
+  if (index == NULL)
+    return;
+
+  for (int i = 0; i < IIDX_1_MAX_CHART_COUNT; ++i)
+  {
+    allocator_free(index->slots[i].note_counts);
+    allocator_free(index->slots[i].ids);
+  }
+  allocator_free(index->songs);
+  allocator_free(index);
+}
+
+static uint32_t lower_bound(const note_index_slot *slot, int note_count)
+{
+  // first position with at least note_count notes.
+  uint32_t low = 0;
+  uint32_t high = slot->count;
+  while (low < high)
+  {
+    uint32_t mid = low + (high - low) / 2;
+    if (slot->note_counts[mid] < note_count)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return low;
+}
+
+int note_index_range(const note_index *index, iidx_1_chart chart, int min_notes, int max_notes,
+                     const uint32_t **out_ids, uint32_t *out_count)
+{
+  if (index == NULL || (uint32_t) chart >= IIDX_1_MAX_CHART_COUNT || out_ids == NULL || out_count == NULL)
+    return -1;
+
+  const note_index_slot *slot = &index->slots[chart];
+  uint32_t begin = lower_bound(slot, min_notes);
+  uint32_t end = max_notes < min_notes ? begin : (max_notes == INT_MAX ? slot->count : lower_bound(slot, max_notes + 1));
+
+  *out_ids = slot->ids + begin;
+  *out_count = end - begin;
+  return 0;
+}
+
+int note_index_top(const note_index *index, iidx_1_chart chart, uint32_t k, uint32_t *out_ids)
+{
+  if (index == NULL || (uint32_t) chart >= IIDX_1_MAX_CHART_COUNT || (out_ids == NULL && k > 0))
+    return -1;
+
+  // the highest note counts are at the end of the slot.
+  const note_index_slot *slot = &index->slots[chart];
+  if (k > slot->count)
+    k = slot->count;
+  for (uint32_t i = 0; i < k; ++i)
+    out_ids[i] = slot->ids[slot->count - 1 - i];
+
+  return (int) k;
+}
+
+uint32_t note_index_get_count(const note_index *index)
+{
+  return index == NULL ? 0 : index->count;
+}
+
+uint32_t note_index_get_chart_count(const note_index *index, iidx_1_chart chart)
+{
+  if (index == NULL || (uint32_t) chart >= IIDX_1_MAX_CHART_COUNT)
+    return 0;
+  return index->slots[chart].count;
+}
+
+const char *note_index_get_music_id(const note_index *index, uint32_t id)
+{
+  if (index == NULL || id >= index->count)
+    return NULL;
+  return index->songs[id].music_id;
+}
+
+int note_index_get_note_count(const note_index *index, uint32_t id, iidx_1_chart chart)
+{
+  if (index == NULL || id >= index->count || (uint32_t) chart >= IIDX_1_MAX_CHART_COUNT)
+    return -1;
+  return index->songs[id].note_counts.charts[chart];
+}
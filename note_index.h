@@ -0,0 +1,41 @@
+#ifndef NOTE_INDEX_H_
+#define NOTE_INDEX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "iidx_note_count.h"
+
+// read-only query index over a scanned library's note counts, for range and top-k queries per chart slot.
+// every slot keeps its songs sorted by note count, so queries are a binary search instead of a pass over the library.
+// songs are identified by their position in the entries the index was built from. empty (0) and failed (-1) charts
+// aren't indexed.
+typedef struct note_index_s note_index;
+
+// create/destroy functions. the entries are copied, they don't need to outlive the index.
+note_index *note_index_create(const iidx_music_note_counts *entries, uint32_t count);
+void note_index_destroy(note_index *index);
+
+// songs with min_notes <= notes <= max_notes on the chart, ordered by note count (ascending).
+// out_ids points into the index and is valid until it is destroyed.
+int note_index_range(const note_index *index, iidx_1_chart chart, int min_notes, int max_notes,
+                     const uint32_t **out_ids, uint32_t *out_count);
+
+// the k songs with the most notes on the chart, written to out_ids from the highest note count down.
+// returns the number of ids written (fewer than k if the slot holds fewer songs), -1 on error.
+int note_index_top(const note_index *index, iidx_1_chart chart, uint32_t k, uint32_t *out_ids);
+
+// getters.
+uint32_t note_index_get_count(const note_index *index);
+uint32_t note_index_get_chart_count(const note_index *index, iidx_1_chart chart);
+const char *note_index_get_music_id(const note_index *index, uint32_t id);
+int note_index_get_note_count(const note_index *index, uint32_t id, iidx_1_chart chart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NOTE_INDEX_H_
@@ -0,0 +1,190 @@
+#include "note_table.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "epoch.h"
+#include "thread.h"
+
+// immutable once published, entries are sorted by music id.
+typedef struct
+{
+  uint32_t generation;
+  uint32_t count;
+  iidx_music_note_counts entries[];
+} note_table_snapshot;
+
+struct note_table_s
+{
+  _Atomic(note_table_snapshot*) current;
+
+  // only touched by publishers.
+  mutex publish_mutex;
+  epoch_retired *retired;
+  uint32_t generation;
+};
+
+static void destroy_snapshot(void *snapshot)
+{
+  allocator_free(snapshot);
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+  return strncmp(((const iidx_music_note_counts*) a)->music_id, ((const iidx_music_note_counts*) b)->music_id,
+                 IIDX_MUSIC_ID_SIZE);
+}
+
+static int compare_music_id(const void *music_id, const void *entry)
+{
+  return strncmp((const char*) music_id, ((const iidx_music_note_counts*) entry)->music_id, IIDX_MUSIC_ID_SIZE);
+}
+
+note_table *note_table_create(void)
+{
+  note_table *ret = (note_table*) allocator_calloc(1, sizeof(note_table));
+  if (ret == NULL)
+    return NULL;
+
+  mutex_init(&ret->publish_mutex);
+  atomic_init(&ret->current, NULL);
+  return ret;
+}
+
+void note_table_destroy(note_table *table)
+{
+  if (table == NULL)
+    return;
+
+  epoch_reclaim_all(&table->retired);
+  allocator_free(atomic_load(&table->current));
+  mutex_destroy(&table->publish_mutex);
+  allocator_free(table);
+}
+
+int note_table_publish(note_table *table, const iidx_music_note_counts *entries, uint32_t count)
+{
+  if (table == NULL || (entries == NULL && count > 0))
+    return -1;
+
+  // build the new snapshot before anyone can see it.
+  note_table_snapshot *snapshot = (note_table_snapshot*) allocator_malloc(sizeof(note_table_snapshot) +
+    (size_t) count * sizeof(iidx_music_note_counts));
+  epoch_retired *retired = (epoch_retired*) allocator_malloc(sizeof(epoch_retired));
+  if (snapshot == NULL || retired == NULL)
+  {
+    allocator_free(snapshot);
+    allocator_free(retired);
+    return -1;
+  }
+  snapshot->count = count;
+  if (count > 0)
+  {
+    memcpy(snapshot->entries, entries, (size_t) count * sizeof(iidx_music_note_counts));
+    qsort(snapshot->entries, count, sizeof(iidx_music_note_counts), compare_entries);
+  }
+
+  mutex_lock(&table->publish_mutex);
+  snapshot->generation = ++table->generation;
+  note_table_snapshot *old_snapshot = atomic_exchange(&table->current, snapshot);
+
+  if (old_snapshot != NULL)
+    epoch_retire(&table->retired, retired, old_snapshot, destroy_snapshot);
+  else
+    allocator_free(retired);
+
+  epoch_reclaim(&table->retired);
+  mutex_unlock(&table->publish_mutex);
+
+  return 0;
+}
+
+int note_table_rebuild(note_table *table, const char **music_ids, uint32_t count)
+{
+  if (table == NULL || (music_ids == NULL && count > 0))
+    return -1;
+
+  iidx_1_note_counts *note_counts = (iidx_1_note_counts*) allocator_malloc((count ? count : 1) * sizeof(iidx_1_note_counts));
+  iidx_music_note_counts *entries = (iidx_music_note_counts*) allocator_malloc((count ? count : 1) * sizeof(iidx_music_note_counts));
+  if (note_counts == NULL || entries == NULL)
+  {
+    allocator_free(note_counts);
+    allocator_free(entries);
+    return -1;
+  }
+
+  get_music_note_counts_batch(music_ids, count, note_counts);
+
+  // failed songs come back with every chart set to -1.
+  uint32_t entry_count = 0;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    int found = 0;
+    for (int chart = 0; chart < IIDX_1_MAX_CHART_COUNT; ++chart)
+      found |= note_counts[i].charts[chart] != -1;
+    if (!found || music_ids[i] == NULL || strlen(music_ids[i]) >= IIDX_MUSIC_ID_SIZE)
+      continue;
+
+    memset(entries[entry_count].music_id, 0, IIDX_MUSIC_ID_SIZE);
+    strcpy(entries[entry_count].music_id, music_ids[i]);
+    entries[entry_count].note_counts = note_counts[i];
+    ++entry_count;
+  }
+
+  int ret = note_table_publish(table, entries, entry_count);
+  allocator_free(note_counts);
+  allocator_free(entries);
+  return ret;
+}
+
+int note_table_find(note_table *table, const char *music_id, iidx_1_note_counts *out_note_counts)
+{
+  if (table == NULL || music_id == NULL || out_note_counts == NULL)
+    return -1;
+
+  epoch_record *record = epoch_enter();
+  if (record == NULL)
+    return -1;
+
+  int ret = -1;
+  const note_table_snapshot *snapshot = atomic_load(&table->current);
+  if (snapshot != NULL)
+  {
+    const iidx_music_note_counts *entry = (const iidx_music_note_counts*) bsearch(music_id, snapshot->entries,
+      snapshot->count, sizeof(iidx_music_note_counts), compare_music_id);
+    if (entry != NULL)
+    {
+      *out_note_counts = entry->note_counts;
+      ret = 0;
+    }
+  }
+  epoch_exit(record);
+
+  return ret;
+}
+
+uint32_t note_table_get_generation(note_table *table)
+{
+  epoch_record *record = table != NULL ? epoch_enter() : NULL;
+  if (record == NULL)
+    return 0;
+
+  const note_table_snapshot *snapshot = atomic_load(&table->current);
+  uint32_t ret = snapshot != NULL ? snapshot->generation : 0;
+  epoch_exit(record);
+  return ret;
+}
+
+uint32_t note_table_get_count(note_table *table)
+{
+  epoch_record *record = table != NULL ? epoch_enter() : NULL;
+  if (record == NULL)
+    return 0;
+
+  const note_table_snapshot *snapshot = atomic_load(&table->current);
+  uint32_t ret = snapshot != NULL ? snapshot->count : 0;
+  epoch_exit(record);
+  return ret;
+}
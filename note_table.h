@@ -0,0 +1,37 @@
+#ifndef NOTE_TABLE_H_
+#define NOTE_TABLE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "iidx_note_count.h"
+
+// in-process table of library note counts that can be replaced while it's being read.
+// every publish builds a new immutable snapshot and swaps it in with a single atomic store, lookups never lock or wait.
+// replaced snapshots are freed once every lookup that might still see them has finished (epoch based reclamation).
+typedef struct note_table_s note_table;
+
+// create/destroy functions. nothing may be reading the table while it's destroyed.
+note_table *note_table_create(void);
+void note_table_destroy(note_table *table);
+
+// replaces the table with a copy of entries. publishers are serialised against each other, never against readers.
+int note_table_publish(note_table *table, const iidx_music_note_counts *entries, uint32_t count);
+// scans the songs (see get_music_note_counts_batch) and publishes the result, songs that fail are left out.
+int note_table_rebuild(note_table *table, const char **music_ids, uint32_t count);
+
+// copies the song's counts out of the current snapshot. returns -1 if it isn't in the table.
+int note_table_find(note_table *table, const char *music_id, iidx_1_note_counts *out_note_counts);
+
+// getters, all read from the current snapshot.
+uint32_t note_table_get_generation(note_table *table);
+uint32_t note_table_get_count(note_table *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NOTE_TABLE_H_
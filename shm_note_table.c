@@ -0,0 +1,276 @@
+#include "shm_note_table.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "allocator.h"
+
+#define SHM_MAGIC 0x4E435431 // "NCT1"
+#define SHM_VERSION 1
+#define MAX_NAME_SIZE 128
+// generations a publish may skip over when their segments are left behind by a publisher that died mid-publish.
+#define MAX_SKIPPED_GENERATIONS 64
+
+// lives in "<name>", tells readers which generation is current.
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  atomic_uint generation; // 0 until the first publish.
+} shm_control;
+
+// start of "<name>.<generation>", followed by count entries sorted by music id.
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t generation;
+  uint32_t count;
+  uint32_t entry_size;
+  uint32_t reserved[3];
+} shm_table_header;
+
+struct shm_note_table_s
+{
+  char name[MAX_NAME_SIZE];
+
+  const shm_control *control;
+
+  // currently mapped generation.
+  const shm_table_header *table;
+  size_t table_size;
+  uint32_t generation;
+};
+
+static int compare_entries(const void *a, const void *b)
+{
+  return strncmp(((const iidx_music_note_counts*) a)->music_id, ((const iidx_music_note_counts*) b)->music_id,
+                 IIDX_MUSIC_ID_SIZE);
+}
+
+static int compare_music_id(const void *music_id, const void *entry)
+{
+  return strncmp((const char*) music_id, ((const iidx_music_note_counts*) entry)->music_id, IIDX_MUSIC_ID_SIZE);
+}
+
+static int get_table_name(const char *name, uint32_t generation, char *out_name)
+{
+  int written = snprintf(out_name, MAX_NAME_SIZE, "%s.%u", name, generation);
+  return written < 0 || written >= MAX_NAME_SIZE ? -1 : 0;
+}
+
+static shm_control *open_control(const char *name, int writable)
+{
+  int fd = shm_open(name, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+  if (fd < 0)
+    return NULL;
+
+  // a fresh control segment is zero filled, which reads as "nothing published yet".
+  struct stat st;
+  if (fstat(fd, &st) || (writable && (size_t) st.st_size < sizeof(shm_control) && ftruncate(fd, sizeof(shm_control))) ||
+      (!writable && (size_t) st.st_size < sizeof(shm_control)))
+  {
+    close(fd);
+    return NULL;
+  }
+
+  void *mapping = mmap(NULL, sizeof(shm_control), writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  return mapping == MAP_FAILED ? NULL : (shm_control*) mapping;
+}
+
+int shm_note_table_publish(const char *name, const iidx_music_note_counts *entries, uint32_t count)
+{
+  if (name == NULL || (entries == NULL && count > 0) || strlen(name) + 12 >= MAX_NAME_SIZE)
+    return -1;
+
+  shm_control *control = open_control(name, 1);
+  if (control == NULL)
+    return -1;
+  control->magic = SHM_MAGIC;
+  control->version = SHM_VERSION;
+
+  uint32_t old_generation = atomic_load(&control->generation);
+  uint32_t generation = old_generation;
+  char table_name[MAX_NAME_SIZE];
+
+  // the new generation is written in full before anyone can see it. a segment that already exists was never published,
+  // it belongs to a publisher that is still writing it or died before it could, either way it's skipped.
+  size_t table_size = sizeof(shm_table_header) + (size_t) count * sizeof(iidx_music_note_counts);
+  int fd = -1;
+  while (fd < 0 && generation - old_generation < MAX_SKIPPED_GENERATIONS)
+  {
+    get_table_name(name, ++generation, table_name);
+    fd = shm_open(table_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 && errno != EEXIST)
+      break;
+  }
+  if (fd < 0)
+  {
+    munmap(control, sizeof(shm_control));
+    return -1;
+  }
+  void *mapping = ftruncate(fd, (off_t) table_size) ? MAP_FAILED :
+    mmap(NULL, table_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+  {
+    shm_unlink(table_name);
+    munmap(control, sizeof(shm_control));
+    return -1;
+  }
+
+  shm_table_header *header = (shm_table_header*) mapping;
+  iidx_music_note_counts *table_entries = (iidx_music_note_counts*) (header + 1);
+  header->magic = SHM_MAGIC;
+  header->version = SHM_VERSION;
+  header->generation = generation;
+  header->count = count;
+  header->entry_size = sizeof(iidx_music_note_counts);
+  if (count > 0)
+  {
+    memcpy(table_entries, entries, (size_t) count * sizeof(iidx_music_note_counts));
+    qsort(table_entries, count, sizeof(iidx_music_note_counts), compare_entries);
+  }
+  munmap(mapping, table_size);
+
+  // publish, only one publisher may win a generation.
+  if (!atomic_compare_exchange_strong_explicit(&control->generation, &old_generation, generation,
+                                               memory_order_release, memory_order_relaxed))
+  {
+    shm_unlink(table_name);
+    munmap(control, sizeof(shm_control));
+    return -1;
+  }
+  munmap(control, sizeof(shm_control));
+
+  // readers still mapping the old generation keep it alive until they switch over. skipped generations can never be
+  // published now, a publisher still writing one fails its exchange.
+  for (uint32_t i = old_generation; i < generation; ++i)
+  {
+    if (i > 0 && get_table_name(name, i, table_name) == 0)
+      shm_unlink(table_name);
+  }
+
+  return 0;
+}
+
+int shm_note_table_unlink(const char *name)
+{
+  if (name == NULL)
+    return -1;
+
+  const shm_control *control = open_control(name, 0);
+  if (control != NULL)
+  {
+    char table_name[MAX_NAME_SIZE];
+    uint32_t generation = atomic_load((atomic_uint*) &control->generation);
+    if (generation > 0 && get_table_name(name, generation, table_name) == 0)
+      shm_unlink(table_name);
+    munmap((void*) control, sizeof(shm_control));
+  }
+
+  return shm_unlink(name);
+}
+
+static int map_generation(shm_note_table *table, uint32_t generation)
+{
+  char table_name[MAX_NAME_SIZE];
+  if (get_table_name(table->name, generation, table_name))
+    return -1;
+
+  // the publisher may already have replaced (and unlinked) this generation, the caller retries later.
+  int fd = shm_open(table_name, O_RDONLY, 0);
+  if (fd < 0)
+    return -1;
+
+  struct stat st;
+  void *mapping = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(shm_table_header))
+    mapping = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return -1;
+
+  // validate before trusting the layout.
+  const shm_table_header *header = (const shm_table_header*) mapping;
+  if (header->magic != SHM_MAGIC || header->version != SHM_VERSION || header->generation != generation ||
+      header->entry_size != sizeof(iidx_music_note_counts) ||
+      sizeof(shm_table_header) + (size_t) header->count * sizeof(iidx_music_note_counts) > (size_t) st.st_size)
+  {
+    munmap(mapping, (size_t) st.st_size);
+    return -1;
+  }
+
+  if (table->table != NULL)
+    munmap((void*) table->table, table->table_size);
+  table->table = header;
+  table->table_size = (size_t) st.st_size;
+  table->generation = generation;
+  return 0;
+}
+
+shm_note_table *shm_note_table_attach(const char *name)
+{
+  if (name == NULL || strlen(name) + 12 >= MAX_NAME_SIZE)
+    return NULL;
+
+  shm_note_table *ret = (shm_note_table*) allocator_calloc(1, sizeof(shm_note_table));
+  if (ret == NULL)
+    return NULL;
+  strcpy(ret->name, name);
+
+  ret->control = open_control(name, 0);
+  if (ret->control == NULL)
+  {
+    allocator_free(ret);
+    return NULL;
+  }
+
+  return ret;
+}
+
+void shm_note_table_detach(shm_note_table *table)
+{
+  if (table == NULL)
+    return;
+
+  if (table->table != NULL)
+    munmap((void*) table->table, table->table_size);
+  munmap((void*) table->control, sizeof(shm_control));
+  allocator_free(table);
+}
+
+const iidx_1_note_counts *shm_note_table_find(shm_note_table *table, const char *music_id)
+{
+  if (table == NULL || music_id == NULL)
+    return NULL;
+
+  // switch over if a newer generation has been published, otherwise keep using the current one.
+  uint32_t generation = atomic_load_explicit((atomic_uint*) &table->control->generation, memory_order_acquire);
+  if (generation != table->generation && generation > 0)
+    map_generation(table, generation);
+  if (table->table == NULL)
+    return NULL;
+
+  const iidx_music_note_counts *entry = (const iidx_music_note_counts*) bsearch(music_id, table->table + 1,
+    table->table->count, sizeof(iidx_music_note_counts), compare_music_id);
+  return entry == NULL ? NULL : &entry->note_counts;
+}
+
+uint32_t shm_note_table_get_generation(const shm_note_table *table)
+{
+  return table == NULL ? 0 : table->generation;
+}
+
+uint32_t shm_note_table_get_count(const shm_note_table *table)
+{
+  return table == NULL || table->table == NULL ? 0 : table->table->count;
+}
@@ -0,0 +1,37 @@
+#ifndef SHM_NOTE_TABLE_H_
+#define SHM_NOTE_TABLE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "iidx_note_count.h"
+
+// library-wide note counts published in POSIX shared memory, so local processes can share one table.
+// every publish creates a new generation segment ("<name>.<generation>"), and a small control segment ("<name>")
+// points readers at the newest one. readers attach read-only and look entries up in place.
+typedef struct shm_note_table_s shm_note_table;
+
+// publisher. name must start with a '/', e.g. "/note_counter".
+int shm_note_table_publish(const char *name, const iidx_music_note_counts *entries, uint32_t count);
+int shm_note_table_unlink(const char *name);
+
+// reader create/destroy functions.
+shm_note_table *shm_note_table_attach(const char *name);
+void shm_note_table_detach(shm_note_table *table);
+
+// switches to a newer generation if one was published, then looks the song up.
+// the returned pointer points into shared memory and is valid until the next find or detach on this reader.
+const iidx_1_note_counts *shm_note_table_find(shm_note_table *table, const char *music_id);
+
+// getters.
+uint32_t shm_note_table_get_generation(const shm_note_table *table);
+uint32_t shm_note_table_get_count(const shm_note_table *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHM_NOTE_TABLE_H_
@@ -0,0 +1,238 @@
+#include "sound_index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <dirent.h>
+  #include <sys/stat.h>
+#endif
+
+#include "allocator.h"
+
+#define MUSIC_ID_SIZE 16
+
+typedef struct
+{
+  char music_id[MUSIC_ID_SIZE];
+  uint32_t root;
+  sound_format format;
+} sound_index_entry;
+
+struct sound_index_s
+{
+  char **roots;
+  uint32_t root_count;
+
+  // sorted by music id, one entry per song.
+  sound_index_entry *entries;
+  uint32_t count;
+  uint32_t capacity;
+};
+
+static int add_entry(sound_index *index, const char *name, size_t name_length, uint32_t root, sound_format format)
+{
+  if (name_length == 0 || name_length >= MUSIC_ID_SIZE)
+    return 0;
+
+  if (index->count == index->capacity)
+  {
+    uint32_t capacity = index->capacity ? index->capacity * 2 : 1024;
+    sound_index_entry *entries = (sound_index_entry*) allocator_realloc(index->entries, capacity * sizeof(sound_index_entry));
+    if (entries == NULL)
+      return -1;
+    index->entries = entries;
+    index->capacity = capacity;
+  }
+
+  sound_index_entry *entry = &index->entries[index->count++];
+  memcpy(entry->music_id, name, name_length);
+  entry->music_id[name_length] = 0;
+  entry->root = root;
+  entry->format = format;
+  return 0;
+}
+
+static int has_chart_file(const char *root_path, const char *name)
+{
+  char path[1024];
+  int written = snprintf(path, sizeof(path), "%s/%s/%s.1", root_path, name, name);
+  if (written < 0 || (size_t) written >= sizeof(path))
+    return 0;
+
+#ifdef _WIN32
+  DWORD attributes = GetFileAttributesA(path);
+  return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+  struct stat st;
+  return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+#endif
+}
+
+static int add_name(sound_index *index, const char *name, int is_directory, uint32_t root)
+{
+  // song folders are named <id>, archives <id>.ifs, everything else is ignored.
+  // a folder without its .1 (e.g. a patch that only replaces the .2dx) mustn't hide the song's ifs in a later root.
+  size_t length = strlen(name);
+  if (is_directory)
+  {
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 || !has_chart_file(index->roots[root], name))
+      return 0;
+    return add_entry(index, name, length, root, SOUND_FORMAT_EXTRACTED);
+  }
+  if (length > 4 && strcmp(name + length - 4, ".ifs") == 0)
+    return add_entry(index, name, length - 4, root, SOUND_FORMAT_IFS);
+  return 0;
+}
+
+static int list_root(sound_index *index, uint32_t root)
+{
+  const char *path = index->roots[root];
+
+#ifdef _WIN32
+  char pattern[MAX_PATH];
+  snprintf(pattern, sizeof(pattern), "%s\\*", path);
+  WIN32_FIND_DATAA data;
+  HANDLE find = FindFirstFileA(pattern, &data);
+  if (find == INVALID_HANDLE_VALUE)
+    return -1;
+
+  int ret = 0;
+  do
+  {
+    ret = add_name(index, data.cFileName, (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0, root);
+  } while (ret == 0 && FindNextFileA(find, &data));
+  FindClose(find);
+  return ret;
+#else
+  DIR *dir = opendir(path);
+  if (dir == NULL)
+    return -1;
+
+  int ret = 0;
+  struct dirent *dirent;
+  while (ret == 0 && (dirent = readdir(dir)) != NULL)
+  {
+    // the directory listing usually tells us the type already, only stat when it doesn't.
+    int is_directory;
+#ifdef DT_DIR
+    if (dirent->d_type != DT_UNKNOWN && dirent->d_type != DT_LNK)
+      is_directory = dirent->d_type == DT_DIR;
+    else
+#endif
+    {
+      char entry_path[1024];
+      struct stat st;
+      snprintf(entry_path, sizeof(entry_path), "%s/%s", path, dirent->d_name);
+      is_directory = stat(entry_path, &st) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    ret = add_name(index, dirent->d_name, is_directory, root);
+  }
+  closedir(dir);
+  return ret;
+#endif
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+  // highest priority root first, then extracted before ifs.
+  const sound_index_entry *entry_a = (const sound_index_entry*) a;
+  const sound_index_entry *entry_b = (const sound_index_entry*) b;
+  int ret = strcmp(entry_a->music_id, entry_b->music_id);
+  if (ret != 0)
+    return ret;
+  if (entry_a->root != entry_b->root)
+    return entry_a->root < entry_b->root ? -1 : 1;
+  return (int) entry_a->format - (int) entry_b->format;
+}
+
+static int compare_music_id(const void *music_id, const void *entry)
+{
+  return strcmp((const char*) music_id, ((const sound_index_entry*) entry)->music_id);
+}
+
+sound_index *sound_index_create(const char **roots, uint32_t root_count)
+{
+  if (roots == NULL || root_count == 0)
+    return NULL;
+
+  sound_index *ret = (sound_index*) allocator_calloc(1, sizeof(sound_index));
+  if (ret == NULL)
+    return NULL;
+
+  ret->roots = (char**) allocator_calloc(root_count, sizeof(char*));
+  if (ret->roots == NULL)
+  {
+    allocator_free(ret);
+    return NULL;
+  }
+  ret->root_count = root_count;
+
+  for (uint32_t i = 0; i < root_count; ++i)
+  {
+    ret->roots[i] = roots[i] != NULL ? (char*) allocator_malloc(strlen(roots[i]) + 1) : NULL;
+    if (ret->roots[i] == NULL)
+    {
+      sound_index_destroy(ret);
+      return NULL;
+    }
+    strcpy(ret->roots[i], roots[i]);
+
+    if (list_root(ret, i))
+    {
+      sound_index_destroy(ret);
+      return NULL;
+    }
+  }
+
+  // keep only the winning entry of every song.
+  if (ret->count > 0)
+  {
+    qsort(ret->entries, ret->count, sizeof(sound_index_entry), compare_entries);
+    uint32_t unique = 1;
+    for (uint32_t i = 1; i < ret->count; ++i)
+    {
+      if (strcmp(ret->entries[i].music_id, ret->entries[unique - 1].music_id) != 0)
+        ret->entries[unique++] = ret->entries[i];
+    }
+    ret->count = unique;
+  }
+
+  return ret;
+}
+
+void sound_index_destroy(sound_index *index)
+{
+  if (index == NULL)
+    return;
+
+  for (uint32_t i = 0; i < index->root_count; ++i)
+    allocator_free(index->roots[i]);
+  allocator_free(index->roots);
+  allocator_free(index->entries);
+  allocator_free(index);
+}
+
+int sound_index_find(const sound_index *index, const char *music_id, const char **out_root, sound_format *out_format)
+{
+  if (index == NULL || music_id == NULL || out_root == NULL || out_format == NULL || index->count == 0)
+    return -1;
+
+  const sound_index_entry *entry = (const sound_index_entry*) bsearch(music_id, index->entries, index->count,
+    sizeof(sound_index_entry), compare_music_id);
+  if (entry == NULL)
+    return -1;
+
+  *out_root = index->roots[entry->root];
+  *out_format = entry->format;
+  return 0;
+}
+
+uint32_t sound_index_get_count(const sound_index *index)
+{
+  return index == NULL ? 0 : index->count;
+}
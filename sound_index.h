@@ -0,0 +1,37 @@
+#ifndef SOUND_INDEX_H_
+#define SOUND_INDEX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// index of where every song lives across one or more sound directories (e.g. a patch directory layered over
+// "data/sound"), built from a single directory listing per root. roots are given highest priority first, the first
+// root holding a song wins, and within a root an extracted folder wins over the ifs. folders only count when they
+// hold the song's .1, so a folder with just the other files of a song doesn't hide its ifs.
+// the index is a snapshot, songs added or removed afterwards aren't seen until it is rebuilt.
+typedef enum
+{
+  SOUND_FORMAT_EXTRACTED = 0, // <root>/<id>/<id>.1
+  SOUND_FORMAT_IFS = 1, // <root>/<id>.ifs
+} sound_format;
+
+typedef struct sound_index_s sound_index;
+
+// create/destroy functions. returns NULL if a root can't be listed.
+sound_index *sound_index_create(const char **roots, uint32_t root_count);
+void sound_index_destroy(sound_index *index);
+
+// returns 0 and where the song lives, -1 if no root has it.
+int sound_index_find(const sound_index *index, const char *music_id, const char **out_root, sound_format *out_format);
+
+// getters.
+uint32_t sound_index_get_count(const sound_index *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SOUND_INDEX_H_
@@ -0,0 +1,88 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../allocator.h"
+#include "../iidx_note_count.h"
+#include "fixture.h"
+
+// custom hooks see every allocation of the library, and can't be swapped out once something was allocated.
+
+static atomic_int live_blocks;
+static int failures;
+
+static void *counting_malloc(size_t size, void *user)
+{
+  (void) user;
+  void *ret = malloc(size);
+  if (ret != NULL)
+    atomic_fetch_add(&live_blocks, 1);
+  return ret;
+}
+
+static void *counting_calloc(size_t count, size_t size, void *user)
+{
+  (void) user;
+  void *ret = calloc(count, size);
+  if (ret != NULL)
+    atomic_fetch_add(&live_blocks, 1);
+  return ret;
+}
+
+static void *counting_realloc(void *ptr, size_t size, void *user)
+{
+  (void) user;
+  void *ret = realloc(ptr, size);
+  if (ret != NULL && ptr == NULL)
+    atomic_fetch_add(&live_blocks, 1);
+  return ret;
+}
+
+static void counting_free(void *ptr, void *user)
+{
+  (void) user;
+  if (ptr != NULL)
+    atomic_fetch_sub(&live_blocks, 1);
+  free(ptr);
+}
+
+static void check(int condition, const char *what)
+{
+  if (!condition)
+  {
+    printf("%s\n", what);
+    ++failures;
+  }
+}
+
+int main(void)
+{
+  static const allocator_hooks counting_hooks = {counting_malloc, counting_calloc, counting_realloc, counting_free, NULL};
+
+  // writing the song doesn't go through the library's allocator, so the hooks are still open.
+  iidx_1_note_counts expected;
+  if (fixture_write_song("data/sound", "94000", 9, 1, &expected))
+  {
+    printf("failed to write the test song\n");
+    return 1;
+  }
+
+  // until the first allocation the hooks may change as often as needed.
+  check(allocator_set_accounting(NULL) == 0, "accounting couldn't be enabled at startup");
+  check(allocator_set_hooks(NULL) == 0, "accounting couldn't be turned off again at startup");
+  check(allocator_set_hooks(&counting_hooks) == 0, "the counting hooks couldn't be installed");
+
+  uint8_t *file;
+  uint32_t file_length;
+  check(load_iidx_1("94000", &file, &file_length) == 0, "failed to load the song");
+  check(atomic_load(&live_blocks) > 0, "the loaded buffer didn't come from the hooks");
+
+  // from now on blocks from the counting hooks are alive, other hooks must not free them.
+  check(allocator_set_hooks(NULL) == -1, "the hooks were changed after the first allocation");
+  check(allocator_set_accounting(NULL) == -1, "accounting was enabled after the first allocation");
+
+  allocator_free(file);
+
+  printf("%d failures\n", failures);
+  return failures != 0;
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../iidx_note_count.h"
+#include "fixture.h"
+
+// batch lookups must give exactly what per-song lookups give, whatever order the songs sit on disk in.
+
+#define SONG_COUNT 24
+
+static int failures;
+
+static void check_batch(const char **music_ids, uint32_t count, int expected_failures, const char *what)
+{
+  static iidx_1_note_counts batch_counts[SONG_COUNT + 2];
+  int batch_failures = get_music_note_counts_batch(music_ids, count, batch_counts);
+  if (batch_failures != expected_failures)
+  {
+    printf("%s: %d songs failed, expected %d\n", what, batch_failures, expected_failures);
+    ++failures;
+  }
+
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    iidx_1_note_counts expected;
+    if (music_ids[i] == NULL || get_music_note_counts(music_ids[i], &expected))
+      memset(&expected, 0xff, sizeof(expected));
+    if (memcmp(&batch_counts[i], &expected, sizeof(expected)) != 0)
+    {
+      printf("%s: %s doesn't match its single lookup\n", what, music_ids[i] != NULL ? music_ids[i] : "(null)");
+      ++failures;
+    }
+  }
+}
+
+int main(void)
+{
+  // written in one order, asked for in another, with a missing and a NULL song mixed in.
+  static char ids[SONG_COUNT][IIDX_MUSIC_ID_SIZE];
+  const char *music_ids[SONG_COUNT + 2];
+  for (uint32_t i = 0; i < SONG_COUNT; ++i)
+  {
+    iidx_1_note_counts expected;
+    snprintf(ids[i], sizeof(ids[i]), "%05u", 91000 + i);
+    if (fixture_write_song("data/sound", ids[i], i * 7 + 3, i % 3 != 0, &expected))
+    {
+      printf("failed to write the test songs\n");
+      return 1;
+    }
+  }
+  for (uint32_t i = 0; i < SONG_COUNT; ++i)
+    music_ids[i] = ids[(i * 5) % SONG_COUNT];
+  music_ids[SONG_COUNT] = "91999";
+  music_ids[SONG_COUNT + 1] = NULL;
+
+  check_batch(music_ids, SONG_COUNT + 2, 2, "data/sound");
+
+  // with the cache on, the second batch is served partly from cached buffers and locations.
+  set_iidx_1_cache_budget(1 << 20);
+  for (uint32_t i = 0; i < SONG_COUNT; i += 2)
+  {
+    iidx_1_note_counts counts;
+    get_music_note_counts(ids[i], &counts);
+    get_chart_note_count(ids[i + 1], IIDX_1_SPN);
+  }
+  check_batch(music_ids, SONG_COUNT + 2, 2, "cached");
+  set_iidx_1_cache_budget(0);
+
+  // through the index.
+  const char *roots[] = {"data/sound"};
+  set_music_roots(roots, 1);
+  check_batch(music_ids, SONG_COUNT + 2, 2, "indexed");
+  set_music_roots(NULL, 0);
+
+  check_batch(music_ids, 0, 0, "empty");
+
+  printf("%d failures\n", failures);
+  return failures > 0;
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../binary_stream.h"
+
+#define EVENT_COUNT (1 << 20)
+#define ITERATIONS 64
+
+static uint8_t events[EVENT_COUNT * 8];
+
+static double bench_runtime(endianness endian, uint64_t *out_sum)
+{
+  clock_t start = clock();
+  uint64_t sum = 0;
+  for (int i = 0; i < ITERATIONS; ++i)
+  {
+    binary_stream *bs = bs_open(events, sizeof(events));
+    bs_set_endianness(bs, endian);
+    while (!bs_at_end(bs))
+    {
+      sum += bs_read_u32(bs);
+      sum += bs_read_u16(bs);
+      sum += bs_read_u16(bs);
+    }
+    bs_close(bs);
+  }
+
+  *out_sum = sum;
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static double bench_le(uint64_t *out_sum)
+{
+  clock_t start = clock();
+  uint64_t sum = 0;
+  for (int i = 0; i < ITERATIONS; ++i)
+  {
+    binary_stream *bs = bs_open(events, sizeof(events));
+    while (!bs_at_end(bs))
+    {
+      sum += bs_read_u32_le(bs);
+      sum += bs_read_u16_le(bs);
+      sum += bs_read_u16_le(bs);
+    }
+    bs_close(bs);
+  }
+
+  *out_sum = sum;
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static double bench_be(uint64_t *out_sum)
+{
+  clock_t start = clock();
+  uint64_t sum = 0;
+  for (int i = 0; i < ITERATIONS; ++i)
+  {
+    binary_stream *bs = bs_open(events, sizeof(events));
+    while (!bs_at_end(bs))
+    {
+      sum += bs_read_u32_be(bs);
+      sum += bs_read_u16_be(bs);
+      sum += bs_read_u16_be(bs);
+    }
+    bs_close(bs);
+  }
+
+  *out_sum = sum;
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(void)
+{
+  // fill with something that isn't trivially foldable.
+  uint32_t seed = 0x12345678;
+  for (uint32_t i = 0; i < sizeof(events); ++i)
+  {
+    seed = seed * 1103515245 + 12345;
+    events[i] = (uint8_t) (seed >> 16);
+  }
+
+  uint64_t runtime_le_sum, runtime_be_sum, le_sum, be_sum;
+  double runtime_le = bench_runtime(BS_LITTLE_ENDIAN, &runtime_le_sum);
+  double runtime_be = bench_runtime(BS_BIG_ENDIAN, &runtime_be_sum);
+  double le = bench_le(&le_sum);
+  double be = bench_be(&be_sum);
+
+  printf("little endian: runtime %.3fs, fixed %.3fs (%.2fx)%s\n", runtime_le, le, runtime_le / le,
+         runtime_le_sum == le_sum ? "" : " MISMATCH");
+  printf("big endian:    runtime %.3fs, fixed %.3fs (%.2fx)%s\n", runtime_be, be, runtime_be / be,
+         runtime_be_sum == be_sum ? "" : " MISMATCH");
+
+  return runtime_le_sum == le_sum && runtime_be_sum == be_sum ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../chart_cache.h"
+#include "../iidx_note_count.h"
+#include "fixture.h"
+
+// two songs with byte-identical charts share one cache entry per chart, the second song is resolved without a scan.
+
+static int failures;
+
+static void check(int condition, const char *what)
+{
+  if (!condition)
+  {
+    printf("%s\n", what);
+    ++failures;
+  }
+}
+
+static uint32_t read32(const uint8_t *p)
+{
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+int main(void)
+{
+  // the same seed builds the same bytes, one song is a folder and the other an ifs.
+  static uint8_t file[FIXTURE_IIDX_1_MAX_SIZE];
+  iidx_1_note_counts expected, first_expected, second_expected;
+  fixture_build_iidx_1(5, file, &expected);
+  if (fixture_write_song("data/sound", "94000", 5, 0, &first_expected) ||
+      fixture_write_song("data/sound", "94001", 5, 1, &second_expected))
+  {
+    printf("failed to write the test songs\n");
+    return 1;
+  }
+
+  chart_cache *cache = chart_cache_create(0);
+  iidx_1_note_counts counts;
+  check(cache != NULL && get_music_note_counts_cached("94000", cache, &counts) == 0 &&
+        memcmp(&counts, &expected, sizeof(counts)) == 0, "94000 counted wrong through the cache");
+  uint32_t entry_count = chart_cache_get_count(cache);
+  check(entry_count > 0, "the first song cached nothing");
+
+  check(get_music_note_counts_cached("94001", cache, &counts) == 0 && memcmp(&counts, &expected, sizeof(counts)) == 0,
+        "94001 counted wrong through the cache");
+  check(chart_cache_get_count(cache) == entry_count, "the identical song added entries");
+
+  // every non-empty chart is referenced twice per slot holding its bytes, once for each song.
+  for (int i = 0; i < IIDX_1_MAX_CHART_COUNT; ++i)
+  {
+    uint32_t offset = read32(file + i * 8), length = read32(file + i * 8 + 4);
+    if (length == 0)
+      continue;
+
+    uint32_t slots = 0;
+    for (int j = 0; j < IIDX_1_MAX_CHART_COUNT; ++j)
+    {
+      uint32_t other_offset = read32(file + j * 8), other_length = read32(file + j * 8 + 4);
+      slots += other_length == length && memcmp(file + offset, file + other_offset, length) == 0;
+    }
+
+    uint64_t hash = chart_cache_hash(file + offset, length);
+    if (chart_cache_get_references(cache, hash, length) != 2 * slots)
+    {
+      printf("chart %d has %u references, expected %u\n", i, chart_cache_get_references(cache, hash, length), 2 * slots);
+      ++failures;
+    }
+  }
+
+  check(chart_cache_get_references(cache, 0, 8) == 0, "a key that was never cached has references");
+  chart_cache_destroy(cache);
+
+  printf("%d failures\n", failures);
+  return failures != 0;
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+
+#include "../allocator.h"
+#include "../iidx_note_count.h"
+#include "fixture.h"
+
+// with the cache on, only the first chart query of an ifs song may decode its manifest, later ones reuse the location
+// until the archive is replaced.
+
+static int failures;
+
+static uint64_t manifest_allocations(void)
+{
+  allocator_stats stats;
+  return allocator_get_stats(ALLOCATOR_STAGE_MANIFEST, &stats) == 0 ? stats.allocation_count : 0;
+}
+
+static long file_size(const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return -1;
+  fseek(file, 0, SEEK_END);
+  long ret = ftell(file);
+  fclose(file);
+  return ret;
+}
+
+static void check(int condition, const char *what)
+{
+  if (!condition)
+  {
+    printf("%s\n", what);
+    ++failures;
+  }
+}
+
+int main(void)
+{
+  // the manifest stage only counts what ifs_open allocates, so it tells us whether the manifest was decoded.
+  if (allocator_set_accounting(NULL))
+    return 1;
+
+  iidx_1_note_counts expected;
+  if (fixture_write_song("data/sound", "90001", 1, 1, &expected))
+  {
+    printf("failed to write the test song\n");
+    return 1;
+  }
+
+  // cache off, every query opens the archive.
+  uint64_t before = manifest_allocations();
+  check(get_chart_note_count("90001", IIDX_1_SPN) == expected.charts[IIDX_1_SPN], "wrong spn count");
+  uint64_t first = manifest_allocations();
+  check(first > before, "the manifest wasn't decoded");
+  check(get_chart_note_count("90001", IIDX_1_SPH) == expected.charts[IIDX_1_SPH], "wrong sph count");
+  check(manifest_allocations() > first, "the manifest was skipped without a cache");
+
+  // cache on, the first query remembers the location and the rest go straight to the chart.
+  set_iidx_1_cache_budget(1 << 20);
+  check(get_chart_note_count("90001", IIDX_1_SPN) == expected.charts[IIDX_1_SPN], "wrong spn count");
+  first = manifest_allocations();
+  for (int chart = 0; chart < IIDX_1_MAX_CHART_COUNT; ++chart)
+    check(get_chart_note_count("90001", (iidx_1_chart) chart) == expected.charts[chart], "wrong cached chart count");
+  check(manifest_allocations() == first, "a later chart query decoded the manifest again");
+
+  // replacing the archive makes the location stale, whether or not it's within the same second. a different size
+  // is enough to notice.
+  long old_size = file_size("data/sound/90001.ifs");
+  uint32_t seed = 2;
+  do
+  {
+    if (fixture_write_song("data/sound", "90001", seed++, 1, &expected))
+    {
+      printf("failed to replace the test song\n");
+      return 1;
+    }
+  } while (file_size("data/sound/90001.ifs") == old_size);
+  for (int chart = 0; chart < IIDX_1_MAX_CHART_COUNT; ++chart)
+    check(get_chart_note_count("90001", (iidx_1_chart) chart) == expected.charts[chart], "a stale location was used");
+  check(manifest_allocations() > first, "the replaced manifest wasn't decoded");
+
+  set_iidx_1_cache_budget(0);
+  printf("%d failures\n", failures);
+  return failures > 0;
+}
@@ -0,0 +1,120 @@
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+#include "../note_counter.hpp"
+#include "fixture.h"
+
+// checks the c++ layer gives the same answers as the c api, errors included. built once as c++17 and once as c++20.
+
+using namespace note_counter;
+
+#if __cplusplus >= 202002L
+static_assert(std::forward_iterator<event_iterator>);
+static_assert(std::sentinel_for<event_sentinel, event_iterator>);
+static_assert(std::forward_iterator<manifest_iterator>);
+#endif
+static_assert(std::is_same<std::iterator_traits<event_iterator>::iterator_category, std::input_iterator_tag>::value,
+  "events are returned by value");
+static_assert(std::is_same<std::iterator_traits<manifest_iterator>::iterator_category, std::input_iterator_tag>::value,
+  "entries are returned by value");
+
+static int failures;
+
+static void check_file(const char *name, std::uint8_t *file, std::uint32_t length)
+{
+  iidx_1_view view(span<const std::uint8_t>(file, length));
+  iidx_1_note_counts counts = view.note_counts();
+  for (int i = 0; i < IIDX_1_MAX_CHART_COUNT; ++i)
+  {
+    int expected = iidx_1_get_note_count(file, length, static_cast<iidx_1_chart>(i));
+    if (counts.charts[i] != expected || view.chart(static_cast<iidx_1_chart>(i)).note_count() != expected)
+    {
+      std::printf("%s chart %d: %d, the c api says %d\n", name, i, counts.charts[i], expected);
+      ++failures;
+    }
+  }
+
+  // slots past the header are errors in both.
+  iidx_1_chart past = static_cast<iidx_1_chart>(IIDX_1_MAX_CHART_COUNT);
+  if (view.chart(past).valid() || view.chart(past).note_count() != iidx_1_get_note_count(file, length, past))
+  {
+    std::printf("%s: a chart past the header isn't an error\n", name);
+    ++failures;
+  }
+}
+
+static void set_chart(std::uint8_t *file, int chart, std::uint32_t offset, std::uint32_t length)
+{
+  for (int i = 0; i < 4; ++i)
+  {
+    file[chart * 8 + i] = static_cast<std::uint8_t>(offset >> (i * 8));
+    file[chart * 8 + 4 + i] = static_cast<std::uint8_t>(length >> (i * 8));
+  }
+}
+
+int main()
+{
+  static std::uint8_t file[FIXTURE_IIDX_1_MAX_SIZE];
+  iidx_1_note_counts expected;
+
+  for (std::uint32_t seed = 1; seed <= 8; ++seed)
+  {
+    std::uint32_t length = fixture_build_iidx_1(seed, file, &expected);
+    check_file("random", file, length);
+
+    // break a few charts the ways the c api rejects: lengths that aren't whole events and ranges past the file.
+    std::uint32_t offset = 0;
+    std::memcpy(&offset, file, sizeof(offset));
+    set_chart(file, 0, offset, 12);
+    set_chart(file, 1, length - 8, 16);
+    set_chart(file, 2, length + 8, 0);
+    set_chart(file, 3, offset, 0);
+    check_file("broken", file, length);
+  }
+
+  // too short to hold a header, every chart fails.
+  check_file("short", file, 40);
+
+  // a song loaded from disk counts the same as through the c api.
+  if (fixture_write_song("data/sound", "92000", 7, 0, &expected))
+  {
+    std::printf("failed to write the test song\n");
+    return 1;
+  }
+  iidx_1_buffer buffer = iidx_1_buffer::load("92000");
+  iidx_1_note_counts counts = buffer.view().note_counts();
+  if (!buffer || std::memcmp(&counts, &expected, sizeof(counts)) != 0)
+  {
+    std::printf("92000 counted differently from the c api\n");
+    ++failures;
+  }
+
+  // a file node without text is skipped instead of parsed, ifs_open rejects the same manifest.
+  xml_document manifest(mxmlNewElement(MXML_NO_PARENT, "imgfs"));
+  mxml_node_t *empty = mxmlNewElement(manifest.get(), "_92000_E0");
+  mxmlElementSetAttr(empty, "__type", "3s32");
+  mxml_node_t *chart = mxmlNewElement(manifest.get(), "_92000_E1");
+  mxmlElementSetAttr(chart, "__type", "3s32");
+  mxmlNewText(chart, 0, "16 32 0");
+  int entries = 0;
+  for (manifest_iterator it(manifest.get(), manifest.get(), 100), end; it != end; ++it)
+  {
+    manifest_entry entry = *it;
+    if (std::strcmp(entry.name, "_92000_E1") != 0 || entry.offset != 116 || entry.size != 32)
+    {
+      std::printf("manifest entry %s read as %u %u\n", entry.name, entry.offset, entry.size);
+      ++failures;
+    }
+    ++entries;
+  }
+  if (entries != 1)
+  {
+    std::printf("%d manifest entries, expected 1\n", entries);
+    ++failures;
+  }
+
+  std::printf("%d failures\n", failures);
+  return failures != 0;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../binary_stream.h"
+#include "../iidx_1.h"
+
+// times iidx_1_decode_events against filling the same columns with per-field bs_read calls.
+
+#define EVENT_COUNT (1 << 22)
+#define ITERATIONS 16
+
+static uint8_t *file;
+static uint32_t file_length;
+static uint32_t *offsets;
+static uint8_t *types, *params;
+static uint16_t *values;
+
+static double bench_bs_read(uint64_t *out_sum)
+{
+  clock_t start = clock();
+  uint64_t sum = 0;
+  for (int i = 0; i < ITERATIONS; ++i)
+  {
+    binary_stream *bs = bs_open(file + 96, file_length - 96);
+    for (uint32_t j = 0; j < EVENT_COUNT; ++j)
+    {
+      offsets[j] = bs_read_u32_le(bs);
+      types[j] = bs_read_u8(bs);
+      params[j] = bs_read_u8(bs);
+      values[j] = bs_read_u16_le(bs);
+    }
+    bs_close(bs);
+    sum += offsets[i] + types[i] + params[i] + values[i];
+  }
+
+  *out_sum = sum;
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static double bench_columns(uint64_t *out_sum)
+{
+  clock_t start = clock();
+  uint64_t sum = 0;
+  iidx_1_event_columns columns = {offsets, types, params, values, EVENT_COUNT};
+  for (int i = 0; i < ITERATIONS; ++i)
+  {
+    if (iidx_1_decode_events(file, file_length, IIDX_1_SPH, &columns) != EVENT_COUNT)
+      return -1;
+    sum += offsets[i] + types[i] + params[i] + values[i];
+  }
+
+  *out_sum = sum;
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(void)
+{
+  file_length = 96 + (EVENT_COUNT + 1) * 8;
+  file = calloc(file_length, 1);
+  offsets = malloc(EVENT_COUNT * sizeof(*offsets));
+  types = malloc(EVENT_COUNT);
+  params = malloc(EVENT_COUNT);
+  values = malloc(EVENT_COUNT * sizeof(*values));
+  if (file == NULL || offsets == NULL || types == NULL || params == NULL || values == NULL)
+  {
+    printf("out of memory\n");
+    return 1;
+  }
+
+  // one chart of random events that never hit the end signature early.
+  uint32_t seed = 0x12345678;
+  for (uint32_t i = 96; i < file_length - 8; ++i)
+  {
+    seed = seed * 1103515245 + 12345;
+    file[i] = (uint8_t) (seed >> 16);
+  }
+  for (uint32_t i = 96; i < file_length - 8; i += 8)
+    file[i + 3] &= 0x3f;
+  uint32_t header[2] = {96, file_length - 96}, end = 0x7fffffff;
+  memcpy(file, header, sizeof(header));
+  memcpy(file + file_length - 8, &end, sizeof(end));
+
+  uint64_t bs_read_sum, columns_sum;
+  double bs_read = bench_bs_read(&bs_read_sum);
+  double columns = bench_columns(&columns_sum);
+  if (columns < 0)
+  {
+    printf("failed to decode the chart\n");
+    return 1;
+  }
+
+  printf("%d events: bs_read %.3fs, columns %.3fs (%.2fx)%s\n", EVENT_COUNT, bs_read, columns, bs_read / columns,
+         bs_read_sum == columns_sum ? "" : " MISMATCH");
+  return bs_read_sum == columns_sum ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../iidx_1.h"
+
+// checks the density analysis against hand-computed values, including windows holding more notes than fit in any
+// small fixed buffer.
+
+#define DENSE_NOTE_COUNT 1000
+
+static uint8_t file[96 + (DENSE_NOTE_COUNT + 16) * 8];
+static uint32_t file_length = 96;
+static int failures;
+
+static void put_u32_le(uint8_t *out, uint32_t value)
+{
+  for (int i = 0; i < 4; ++i)
+    out[i] = (uint8_t) (value >> (i * 8));
+}
+
+static void begin_chart(iidx_1_chart chart)
+{
+  put_u32_le(file + chart * 8, file_length);
+}
+
+static void add_event(uint32_t offset, uint8_t type, uint16_t value)
+{
+  put_u32_le(file + file_length, offset);
+  file[file_length + 4] = type;
+  file[file_length + 5] = 0;
+  file[file_length + 6] = (uint8_t) value;
+  file[file_length + 7] = (uint8_t) (value >> 8);
+  file_length += 8;
+}
+
+static void end_chart(iidx_1_chart chart)
+{
+  add_event(0x7fffffff, 0, 0);
+  uint32_t offset = file[chart * 8] | file[chart * 8 + 1] << 8 | file[chart * 8 + 2] << 16 | (uint32_t) file[chart * 8 + 3] << 24;
+  put_u32_le(file + chart * 8 + 4, file_length - offset);
+}
+
+static void check(uint32_t value, uint32_t expected, const char *what)
+{
+  if (value != expected)
+  {
+    printf("%s is %u, expected %u\n", what, value, expected);
+    ++failures;
+  }
+}
+
+int main(void)
+{
+  // a chord at 0, a note at 100, a charge note at 1000, a note at 1500 and a bpm change at 1600.
+  begin_chart(IIDX_1_SPH);
+  add_event(0, 0, 0);
+  add_event(0, 1, 0);
+  add_event(100, 0, 0);
+  add_event(1000, 1, 50);
+  add_event(1500, 0, 0);
+  add_event(1600, 4, 150);
+  end_chart(IIDX_1_SPH);
+
+  // 1000 notes 5ms apart, all inside one 10s window.
+  begin_chart(IIDX_1_SPN);
+  for (uint32_t i = 0; i < DENSE_NOTE_COUNT; ++i)
+    add_event(i * 5, (uint8_t) (i % 2), 0);
+  end_chart(IIDX_1_SPN);
+
+  // a note right before the end signature's offset, with a window of 1 every window in between is empty.
+  begin_chart(IIDX_1_SPA);
+  add_event(0, 0, 0);
+  add_event(0x7ffffffe, 1, 0);
+  end_chart(IIDX_1_SPA);
+
+  iidx_1_note_density density;
+  if (iidx_1_get_note_density(file, file_length, IIDX_1_SPH, 1000, &density))
+  {
+    printf("failed to analyse the short chart\n");
+    return 1;
+  }
+  check((uint32_t) density.note_count, 6, "short note count");
+  check(density.duration, 1600, "short duration");
+  check(density.peak_density, 3, "short peak density");
+  check(density.peak_offset, 100, "short peak offset");
+  // [0, 1000) holds the chord and the note at 100, [1000, 2000) the charge note and the note at 1500.
+  check(density.histogram[3], 2, "short windows with 3 notes");
+  for (int i = 0; i < IIDX_1_DENSITY_BUCKET_COUNT; ++i)
+    check(i == 3 ? 0 : density.histogram[i], 0, "short other windows");
+
+  if (iidx_1_get_note_density(file, file_length, IIDX_1_SPN, 10000, &density))
+  {
+    printf("failed to analyse the dense chart\n");
+    return 1;
+  }
+  check((uint32_t) density.note_count, DENSE_NOTE_COUNT, "dense note count");
+  check(density.peak_density, DENSE_NOTE_COUNT, "dense peak density");
+  check(density.peak_offset, (DENSE_NOTE_COUNT - 1) * 5, "dense peak offset");
+  check(density.histogram[IIDX_1_DENSITY_BUCKET_COUNT - 1], 1, "dense windows in the last bucket");
+
+  // a 1s window slides over 200 notes at a time.
+  if (iidx_1_get_note_density(file, file_length, IIDX_1_SPN, 1000, &density))
+    return 1;
+  check(density.peak_density, 200, "sliding peak density");
+  check(density.peak_offset, 995, "sliding peak offset");
+
+  // the empty windows are counted at once, not one at a time.
+  if (iidx_1_get_note_density(file, file_length, IIDX_1_SPA, 1, &density))
+    return 1;
+  check(density.duration, 0x7ffffffe, "far duration");
+  check(density.histogram[1], 2, "far windows with a note");
+  check(density.histogram[0], 0x7ffffffd, "far empty windows");
+  check(density.peak_density, 1, "far peak density");
+
+  printf("%d failures\n", failures);
+  return failures > 0;
+}
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../iidx_1.h"
+
+// decodes charts into columns and compares them with the events read one at a time, at sizes around the 256 event
+// blocks iidx_1_decode_events works in.
+
+#define MAX_EVENT_COUNT 1024
+
+typedef struct
+{
+  uint32_t offset;
+  uint8_t type;
+  uint8_t param;
+  uint16_t value;
+} event;
+
+static uint8_t file[96 + 4 * (MAX_EVENT_COUNT + 8) * 8];
+static uint32_t file_length = 96;
+static uint32_t seed = 0x2545f491;
+static int failures;
+
+static void put_u32_le(uint8_t *out, uint32_t value)
+{
+  for (int i = 0; i < 4; ++i)
+    out[i] = (uint8_t) (value >> (i * 8));
+}
+
+static void add_event(uint32_t offset, uint8_t type, uint8_t param, uint16_t value)
+{
+  put_u32_le(file + file_length, offset);
+  file[file_length + 4] = type;
+  file[file_length + 5] = param;
+  file[file_length + 6] = (uint8_t) value;
+  file[file_length + 7] = (uint8_t) (value >> 8);
+  file_length += 8;
+}
+
+// count random events and the end signature, then trailing_count more random events the decode must not reach.
+static void add_chart(iidx_1_chart chart, uint32_t count, uint32_t trailing_count)
+{
+  uint32_t start = file_length;
+  for (uint32_t i = 0; i < count + 1 + trailing_count; ++i)
+  {
+    seed = seed * 1103515245 + 12345;
+    uint32_t offset = i == count ? 0x7fffffff : (seed >> 1) % 0x7fffffff;
+    add_event(offset, (uint8_t) (seed >> 8), (uint8_t) (seed >> 16), (uint16_t) (seed >> 13));
+  }
+  put_u32_le(file + chart * 8, start);
+  put_u32_le(file + chart * 8 + 4, file_length - start);
+}
+
+// the array of structures reference, straight from the bytes.
+static event read_event(iidx_1_chart chart, uint32_t index)
+{
+  const uint8_t *header = file + chart * 8;
+  const uint8_t *p = file + (header[0] | header[1] << 8 | header[2] << 16 | (uint32_t) header[3] << 24) + index * 8;
+  event ret = {p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24, p[4], p[5], (uint16_t) (p[6] | p[7] << 8)};
+  return ret;
+}
+
+static void check_chart(iidx_1_chart chart, int expected_count)
+{
+  static uint32_t offsets[MAX_EVENT_COUNT + 1];
+  static uint8_t types[MAX_EVENT_COUNT + 1], params[MAX_EVENT_COUNT + 1];
+  static uint16_t values[MAX_EVENT_COUNT + 1];
+
+  int count = iidx_1_get_event_count(file, file_length, chart);
+  if (count != expected_count)
+  {
+    printf("chart %d has %d events, expected %d\n", chart, count, expected_count);
+    ++failures;
+    return;
+  }
+
+  // the entry past the count must be left alone.
+  memset(offsets, 0xaa, sizeof(offsets));
+  memset(types, 0xaa, sizeof(types));
+  memset(params, 0xaa, sizeof(params));
+  memset(values, 0xaa, sizeof(values));
+  iidx_1_event_columns columns = {offsets, types, params, values, (uint32_t) count};
+  if (iidx_1_decode_events(file, file_length, chart, &columns) != count)
+  {
+    printf("failed to decode chart %d\n", chart);
+    ++failures;
+    return;
+  }
+
+  for (int i = 0; i < count; ++i)
+  {
+    event e = read_event(chart, (uint32_t) i);
+    if (offsets[i] != e.offset || types[i] != e.type || params[i] != e.param || values[i] != e.value)
+    {
+      printf("chart %d event %d decoded differently\n", chart, i);
+      ++failures;
+      return;
+    }
+  }
+  if (offsets[count] != 0xaaaaaaaa || types[count] != 0xaa || params[count] != 0xaa || values[count] != 0xaaaa)
+  {
+    printf("chart %d wrote past its events\n", chart);
+    ++failures;
+  }
+
+  // skipped columns stay untouched while the others are still filled.
+  memset(offsets, 0, sizeof(offsets));
+  memset(params, 0, sizeof(params));
+  memset(types, 0xaa, sizeof(types));
+  memset(values, 0xaa, sizeof(values));
+  iidx_1_event_columns partial = {offsets, NULL, params, NULL, (uint32_t) count};
+  if (iidx_1_decode_events(file, file_length, chart, &partial) != count ||
+      (count > 0 && (offsets[count - 1] != read_event(chart, (uint32_t) count - 1).offset ||
+                     params[count - 1] != read_event(chart, (uint32_t) count - 1).param)) ||
+      types[0] != 0xaa || values[0] != 0xaaaa)
+  {
+    printf("chart %d decoded the wrong columns\n", chart);
+    ++failures;
+  }
+
+  // too little room is an error, nothing is decoded.
+  if (count > 0)
+  {
+    iidx_1_event_columns small = {offsets, types, params, values, (uint32_t) count - 1};
+    if (iidx_1_decode_events(file, file_length, chart, &small) != -1)
+    {
+      printf("chart %d decoded into columns that are too small\n", chart);
+      ++failures;
+    }
+  }
+}
+
+int main(void)
+{
+  add_chart(IIDX_1_SPH, 700, 0);  // two whole blocks and a partial one.
+  add_chart(IIDX_1_SPN, 256, 3);  // exactly one block, with events after the end.
+  add_chart(IIDX_1_SPA, 257, 0);  // one event into the second block.
+  add_chart(IIDX_1_SPB, 1, 0);
+  add_chart(IIDX_1_DPH, 0, 5);    // only the end signature.
+  add_chart(IIDX_1_DPN, MAX_EVENT_COUNT, 0);
+
+  check_chart(IIDX_1_SPH, 700);
+  check_chart(IIDX_1_SPN, 256);
+  check_chart(IIDX_1_SPA, 257);
+  check_chart(IIDX_1_SPB, 1);
+  check_chart(IIDX_1_DPH, 0);
+  check_chart(IIDX_1_DPN, MAX_EVENT_COUNT);
+
+  // a chart length that isn't a whole number of events is rejected, like the note counts do.
+  put_u32_le(file + IIDX_1_SPH * 8 + 4, 700 * 8 + 4);
+  uint32_t offset;
+  iidx_1_event_columns columns = {&offset, NULL, NULL, NULL, 1};
+  if (iidx_1_get_event_count(file, file_length, IIDX_1_SPH) != -1 ||
+      iidx_1_decode_events(file, file_length, IIDX_1_SPH, &columns) != -1)
+  {
+    printf("a partial event was accepted\n");
+    ++failures;
+  }
+
+  printf("%d failures\n", failures);
+  return failures != 0;
+}
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+  #include <dirent.h>
+#endif
+
+#include "../ifs.h"
+#include "../ifs_internal.h"
+#include "../iidx_note_count.h"
+#include "fixture.h"
+
+// extracts songs out of layered roots and checks what lands where, copies a large entry with every fallback the
+// extraction has, checks files are only ever replaced whole, and checks manifest names that would climb out of the
+// root or are nested deeper than the path limit are rejected.
+
+#define LARGE_ENTRY_SIZE (300 * 1024 + 13)
+
+static int failures;
+
+static void check(int condition, const char *what)
+{
+  if (!condition)
+  {
+    printf("%s\n", what);
+    ++failures;
+  }
+}
+
+static uint8_t *read_file(const char *path, uint32_t *out_length)
+{
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return NULL;
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  uint8_t *ret = (uint8_t*) malloc(length > 0 ? (size_t) length : 1);
+  if (ret != NULL && fread(ret, 1, (size_t) length, file) != (size_t) length)
+  {
+    free(ret);
+    ret = NULL;
+  }
+  fclose(file);
+  *out_length = (uint32_t) length;
+  return ret;
+}
+
+static int file_matches(const char *path, const uint8_t *expected, uint32_t expected_length)
+{
+  uint32_t length;
+  uint8_t *data = read_file(path, &length);
+  int ret = data != NULL && length == expected_length && memcmp(data, expected, length) == 0;
+  free(data);
+  return ret;
+}
+
+static int count_directory_entries(const char *path)
+{
+#ifdef _WIN32
+  (void) path;
+  return 1;
+#else
+  DIR *directory = opendir(path);
+  if (directory == NULL)
+    return -1;
+  int ret = 0;
+  for (struct dirent *entry = readdir(directory); entry != NULL; entry = readdir(directory))
+  {
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+      ++ret;
+  }
+  closedir(directory);
+  return ret;
+#endif
+}
+
+static int file_exists(const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if (file != NULL)
+    fclose(file);
+  return file != NULL;
+}
+
+static void check_songs(void)
+{
+  static uint8_t chart[FIXTURE_IIDX_1_MAX_SIZE];
+  iidx_1_note_counts expected;
+  int failed = 0;
+
+  // 93000 is an ifs in the patch root, 93001 in the data root and 93002 is already extracted in the patch root.
+  failed |= fixture_write_song("extract/patch", "93000", 1, 1, &expected);
+  failed |= fixture_write_song("extract/data", "93001", 2, 1, &expected);
+  failed |= fixture_write_song("extract/data", "93002", 3, 1, &expected);
+  failed |= fixture_write_song("extract/patch", "93002", 4, 0, &expected);
+  failed |= fixture_write_song("extract/data", "93003", 5, 1, &expected);
+  // the song folder _E_E unescapes to "..", its chart to "...1".
+  failed |= fixture_write_song("extract/data", "E_E", 6, 1, &expected);
+  if (failed)
+  {
+    printf("failed to write the test songs\n");
+    ++failures;
+    return;
+  }
+
+  const char *roots[] = {"extract/patch", "extract/data"};
+  if (set_music_roots(roots, 2))
+  {
+    printf("failed to index the roots\n");
+    ++failures;
+    return;
+  }
+
+  const char *music_ids[] = {"93000", "93001", "93002", "93999"};
+  check(extract_music(music_ids, 4, 0, 2) == 1, "only the missing song should fail to extract");
+
+  uint32_t length = fixture_build_iidx_1(1, chart, &expected);
+  check(file_matches("extract/patch/93000/93000.1", chart, length), "93000 wasn't extracted next to its ifs");
+  check(file_exists("extract/patch/93000/93000.2"), "93000's other files weren't extracted");
+  length = fixture_build_iidx_1(2, chart, &expected);
+  check(file_matches("extract/data/93001/93001.1", chart, length), "93001 wasn't extracted next to its ifs");
+  check(!file_exists("extract/data/93002"), "93002 was extracted from the ifs its folder shadows");
+  check(!file_exists("data/sound"), "something was extracted into data/sound");
+
+  // manifest names that climb out of the root are refused.
+  const char *escaping_ids[] = {"E_E"};
+  check(extract_music(escaping_ids, 1, 0, 1) == 1, "a song escaping its root was extracted");
+  check(!file_exists("extract/...1") && !file_exists("extract/data/...1"), "a chart was written outside its folder");
+
+  // charts only leaves the other files in the archive.
+  const char *chart_ids[] = {"93003"};
+  check(extract_music(chart_ids, 1, 1, 1) == 0, "93003 failed to extract");
+  length = fixture_build_iidx_1(5, chart, &expected);
+  check(file_matches("extract/data/93003/93003.1", chart, length), "93003's chart wasn't extracted");
+  check(!file_exists("extract/data/93003/93003.2"), "charts only extracted more than the chart");
+
+  // once indexed again the extracted songs are found in their folders.
+  iidx_1_note_counts counts;
+  set_music_roots(roots, 2);
+  fixture_build_iidx_1(2, chart, &expected);
+  check(get_music_note_counts("93001", &counts) == 0 && memcmp(&counts, &expected, sizeof(counts)) == 0,
+        "93001 counts differently once extracted");
+  set_music_roots(NULL, 0);
+}
+
+static void check_copy_methods(void)
+{
+  // larger than a chunk of the read fallback, with a size that doesn't divide evenly.
+  uint8_t *large = (uint8_t*) malloc(LARGE_ENTRY_SIZE);
+  if (large == NULL)
+    return;
+  uint32_t state = 77;
+  for (uint32_t i = 0; i < LARGE_ENTRY_SIZE; ++i)
+  {
+    state = state * 1664525u + 1013904223u;
+    large[i] = (uint8_t) (state >> 24);
+  }
+
+  ifs_archive *archive = NULL;
+  if (fixture_make_directories("copy") || fixture_write_ifs("copy/93100.ifs", "93100", large, LARGE_ENTRY_SIZE) ||
+      ifs_open("copy/93100.ifs", &archive) != IFS_NO_ERROR)
+  {
+    printf("failed to write the large archive\n");
+    ++failures;
+    free(large);
+    return;
+  }
+  const ifs_entry *entry = ifs_find_entry(archive, "imgfs/_93100/_93100_E1");
+
+  // every method on its own, then none so only the chunked reads are left.
+  static const unsigned method_sets[] = {IFS_COPY_ALL, IFS_COPY_FILE_RANGE, IFS_COPY_SENDFILE, IFS_COPY_MAPPING, 0};
+  for (uint32_t i = 0; i < sizeof(method_sets) / sizeof(method_sets[0]); ++i)
+  {
+    char out_path[64];
+    snprintf(out_path, sizeof(out_path), "copy/out_%u.1", i);
+    ifs_set_copy_methods(method_sets[i]);
+    if (entry == NULL || ifs_extract_entry(archive, entry, out_path) != IFS_NO_ERROR ||
+        !file_matches(out_path, large, LARGE_ENTRY_SIZE))
+    {
+      printf("copying with methods 0x%x failed\n", method_sets[i]);
+      ++failures;
+    }
+  }
+  ifs_set_copy_methods(IFS_COPY_ALL);
+
+  // an existing file is replaced as a whole.
+  FILE *stale = fopen("copy/replaced.1", "wb");
+  if (stale != NULL)
+  {
+    fwrite(large, 1, LARGE_ENTRY_SIZE, stale);
+    fwrite(large, 1, LARGE_ENTRY_SIZE, stale);
+    fclose(stale);
+  }
+  check(entry != NULL && ifs_extract_entry(archive, entry, "copy/replaced.1") == IFS_NO_ERROR &&
+        file_matches("copy/replaced.1", large, LARGE_ENTRY_SIZE), "an existing file wasn't replaced");
+
+  // a copy that can't be put in place leaves nothing behind, not even its temporary file.
+  check(fixture_make_directories("copy/blocked/in_the_way.1") == 0 && entry != NULL &&
+        ifs_extract_entry(archive, entry, "copy/blocked/in_the_way.1") != IFS_NO_ERROR,
+        "extracting over a directory succeeded");
+  check(count_directory_entries("copy/blocked") == 1, "a failed extraction left a file behind");
+
+  ifs_close(archive);
+  free(large);
+}
+
+static void check_depth(void)
+{
+  // 32 nodes is the deepest path an archive may hold.
+  ifs_archive *archive = NULL;
+  check(fixture_write_nested_ifs("copy/deep.ifs", 32) == 0 && ifs_open("copy/deep.ifs", &archive) == IFS_NO_ERROR &&
+        ifs_get_entry_count(archive) == 1, "a 32 node deep file was rejected");
+  ifs_close(archive);
+
+  archive = NULL;
+  check(fixture_write_nested_ifs("copy/too_deep.ifs", 33) == 0 &&
+        ifs_open("copy/too_deep.ifs", &archive) == IFS_MANIFEST_PARSE_ERROR, "a 33 node deep file wasn't rejected");
+  ifs_close(archive);
+}
+
+int main(void)
+{
+  check_songs();
+  check_copy_methods();
+  check_depth();
+
+  printf("%d failures\n", failures);
+  return failures != 0;
+}
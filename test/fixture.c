@@ -0,0 +1,232 @@
+#include "fixture.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <direct.h>
+  #define make_directory(path) _mkdir(path)
+#else
+  #include <sys/stat.h>
+  #define make_directory(path) mkdir(path, 0755)
+#endif
+
+static uint32_t next_random(uint32_t *state)
+{
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 8;
+}
+
+static void put_u16_le(uint8_t *out, uint16_t value)
+{
+  out[0] = (uint8_t) value;
+  out[1] = (uint8_t) (value >> 8);
+}
+
+static void put_u32_le(uint8_t *out, uint32_t value)
+{
+  put_u16_le(out, (uint16_t) value);
+  put_u16_le(out + 2, (uint16_t) (value >> 16));
+}
+
+static void put_u32_be(uint8_t *out, uint32_t value)
+{
+  out[0] = (uint8_t) (value >> 24);
+  out[1] = (uint8_t) (value >> 16);
+  out[2] = (uint8_t) (value >> 8);
+  out[3] = (uint8_t) value;
+}
+
+uint32_t fixture_build_iidx_1(uint32_t seed, uint8_t *out, iidx_1_note_counts *out_expected)
+{
+  // a few charts are left empty, like the unused difficulties of a real song.
+  static const uint8_t event_types[] = {0, 0, 0, 1, 4, 5};
+  uint32_t state = seed;
+  uint32_t length = 96;
+  for (uint32_t chart = 0; chart < IIDX_1_MAX_CHART_COUNT; ++chart)
+  {
+    uint32_t event_count = chart == 4 || chart == 5 || chart >= 9 ? 0 : 50 + chart * 37 + seed % 17;
+    out_expected->charts[chart] = 0;
+    put_u32_le(out + chart * 8, event_count > 0 ? length : 0);
+    put_u32_le(out + chart * 8 + 4, event_count > 0 ? (event_count + 1) * 8 : 0);
+    if (event_count == 0)
+      continue;
+
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < event_count; ++i)
+    {
+      uint8_t type = event_types[next_random(&state) % sizeof(event_types)];
+      uint16_t value = type <= 1 && next_random(&state) % 4 == 0 ? 30 : 0;
+      offset += next_random(&state) % 200;
+      put_u32_le(out + length, offset);
+      out[length + 4] = type;
+      out[length + 5] = (uint8_t) (next_random(&state) % 8);
+      put_u16_le(out + length + 6, value);
+      length += 8;
+
+      if (type <= 1)
+        out_expected->charts[chart] += value > 0 ? 2 : 1;
+    }
+
+    put_u32_le(out + length, 0x7fffffff);
+    memset(out + length + 4, 0, 4);
+    length += 8;
+  }
+
+  return length;
+}
+
+static uint32_t put_node_name(uint8_t *out, const char *name)
+{
+  uint32_t length = (uint32_t) strlen(name);
+  out[0] = (uint8_t) (0x40 | length);
+  memcpy(out + 1, name, length);
+  return length + 1;
+}
+
+static int write_ifs(const char *path, const uint8_t *nodes, uint32_t nodes_length, const uint8_t *data,
+                     uint32_t data_length, const uint8_t **files, const uint32_t *file_lengths, uint32_t file_count)
+{
+  // an uncompressed kbinxml manifest followed by the files.
+  uint8_t header[20];
+  uint8_t manifest_header[8] = {0xA0, 0x45, 0xE8, 0x17};
+  uint8_t data_header[4];
+  put_u32_be(manifest_header + 4, nodes_length);
+  put_u32_be(data_header, data_length);
+  put_u32_be(header, 0x6CAD8F89);
+  header[4] = 0; header[5] = 1; // version.
+  header[6] = 0xff; header[7] = 0xfe;
+  put_u32_be(header + 8, 0);
+  put_u32_be(header + 12, 0);
+  put_u32_be(header + 16, sizeof(header) + sizeof(manifest_header) + nodes_length + sizeof(data_header) + data_length);
+
+  FILE *file = fopen(path, "wb");
+  if (file == NULL)
+    return -1;
+  fwrite(header, 1, sizeof(header), file);
+  fwrite(manifest_header, 1, sizeof(manifest_header), file);
+  fwrite(nodes, 1, nodes_length, file);
+  fwrite(data_header, 1, sizeof(data_header), file);
+  fwrite(data, 1, data_length, file);
+  for (uint32_t i = 0; i < file_count; ++i)
+    fwrite(files[i], 1, file_lengths[i], file);
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+int fixture_write_ifs(const char *path, const char *music_id, const uint8_t *chart_file, uint32_t chart_length)
+{
+  // imgfs/_<id>/{_<id>_E2, _<id>_E1}.
+  static const uint8_t other_file[77] = {0x11};
+  char folder_name[32];
+  char chart_name[32];
+  char other_name[32];
+  snprintf(folder_name, sizeof(folder_name), "_%s", music_id);
+  snprintf(chart_name, sizeof(chart_name), "_%s_E1", music_id);
+  snprintf(other_name, sizeof(other_name), "_%s_E2", music_id);
+
+  uint8_t nodes[256];
+  uint32_t nodes_length = 0;
+  nodes[nodes_length++] = 1;
+  nodes_length += put_node_name(nodes + nodes_length, "imgfs");
+  nodes[nodes_length++] = 1;
+  nodes_length += put_node_name(nodes + nodes_length, folder_name);
+  nodes[nodes_length++] = 30; // 3s32.
+  nodes_length += put_node_name(nodes + nodes_length, other_name);
+  nodes[nodes_length++] = 190;
+  nodes[nodes_length++] = 30;
+  nodes_length += put_node_name(nodes + nodes_length, chart_name);
+  nodes[nodes_length++] = 190;
+  nodes[nodes_length++] = 190;
+  nodes[nodes_length++] = 190;
+  nodes[nodes_length++] = 191;
+  while (nodes_length % 4)
+    nodes[nodes_length++] = 0;
+
+  // offset, size and time of every file, relative to the end of the manifest.
+  uint8_t data[24];
+  put_u32_be(data, 0);
+  put_u32_be(data + 4, sizeof(other_file));
+  put_u32_be(data + 8, 0);
+  put_u32_be(data + 12, sizeof(other_file));
+  put_u32_be(data + 16, chart_length);
+  put_u32_be(data + 20, 0);
+
+  const uint8_t *files[2] = {other_file, chart_file};
+  uint32_t file_lengths[2] = {sizeof(other_file), chart_length};
+  return write_ifs(path, nodes, nodes_length, data, sizeof(data), files, file_lengths, 2);
+}
+
+int fixture_write_nested_ifs(const char *path, uint32_t depth)
+{
+  // d/d/.../f, with depth nodes in total.
+  static const uint8_t file_data[16] = {0x22};
+  uint8_t nodes[4 * FIXTURE_MAX_NESTED_DEPTH + 8];
+  uint32_t nodes_length = 0;
+  if (depth == 0 || depth > FIXTURE_MAX_NESTED_DEPTH)
+    return -1;
+
+  for (uint32_t i = 0; i + 1 < depth; ++i)
+  {
+    nodes[nodes_length++] = 1;
+    nodes_length += put_node_name(nodes + nodes_length, "d");
+  }
+  nodes[nodes_length++] = 30;
+  nodes_length += put_node_name(nodes + nodes_length, "f");
+  for (uint32_t i = 0; i < depth; ++i)
+    nodes[nodes_length++] = 190;
+  nodes[nodes_length++] = 191;
+  while (nodes_length % 4)
+    nodes[nodes_length++] = 0;
+
+  uint8_t data[12];
+  put_u32_be(data, 0);
+  put_u32_be(data + 4, sizeof(file_data));
+  put_u32_be(data + 8, 0);
+
+  const uint8_t *files[1] = {file_data};
+  uint32_t file_lengths[1] = {sizeof(file_data)};
+  return write_ifs(path, nodes, nodes_length, data, sizeof(data), files, file_lengths, 1);
+}
+
+int fixture_write_song(const char *root, const char *music_id, uint32_t seed, int as_ifs, iidx_1_note_counts *out_expected)
+{
+  static uint8_t chart_file[FIXTURE_IIDX_1_MAX_SIZE];
+  uint32_t chart_length = fixture_build_iidx_1(seed, chart_file, out_expected);
+
+  char path[512];
+  if (as_ifs)
+  {
+    snprintf(path, sizeof(path), "%s/%s.ifs", root, music_id);
+    return fixture_make_directories(root) || fixture_write_ifs(path, music_id, chart_file, chart_length) ? -1 : 0;
+  }
+
+  snprintf(path, sizeof(path), "%s/%s", root, music_id);
+  if (fixture_make_directories(path))
+    return -1;
+  snprintf(path, sizeof(path), "%s/%s/%s.1", root, music_id, music_id);
+  FILE *file = fopen(path, "wb");
+  if (file == NULL)
+    return -1;
+  fwrite(chart_file, 1, chart_length, file);
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+int fixture_make_directories(const char *path)
+{
+  char partial[512];
+  size_t length = strlen(path);
+  if (length >= sizeof(partial))
+    return -1;
+
+  for (size_t i = 1; i <= length; ++i)
+  {
+    if (path[i] != '/' && path[i] != 0)
+      continue;
+    memcpy(partial, path, i);
+    partial[i] = 0;
+    if (make_directory(partial) && errno != EEXIST)
+      return -1;
+  }
+  return 0;
+}
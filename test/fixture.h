@@ -0,0 +1,37 @@
+#ifndef TEST_FIXTURE_H_
+#define TEST_FIXTURE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../iidx_1.h"
+
+// helpers shared by the tests for writing songs to disk, they never touch files a test didn't ask for.
+
+// big enough for any file fixture_build_iidx_1 writes.
+#define FIXTURE_IIDX_1_MAX_SIZE (96 + IIDX_1_MAX_CHART_COUNT * 512 * 8)
+
+// builds a random .1 file from seed, charts 4, 5 and 9+ are left empty. returns its length.
+uint32_t fixture_build_iidx_1(uint32_t seed, uint8_t *out, iidx_1_note_counts *out_expected);
+
+// writes chart_file as the only chart (_<id>_E1) of an ifs, next to a dummy _<id>_E2 entry.
+int fixture_write_ifs(const char *path, const char *music_id, const uint8_t *chart_file, uint32_t chart_length);
+
+// writes an ifs holding a single file nested depth manifest nodes deep (d/d/.../f).
+#define FIXTURE_MAX_NESTED_DEPTH 64
+int fixture_write_nested_ifs(const char *path, uint32_t depth);
+
+// writes a song built from seed to <root>/<id>/<id>.1, or to <root>/<id>.ifs when as_ifs is set.
+int fixture_write_song(const char *root, const char *music_id, uint32_t seed, int as_ifs, iidx_1_note_counts *out_expected);
+
+// creates path and all its parents, like mkdir -p.
+int fixture_make_directories(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEST_FIXTURE_H_
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../ifs.h"
+#include "fixture.h"
+
+// the archive api on its own: entry lookup, reads at offsets, the mapping and rejecting ranges past an entry.
+
+static int failures;
+
+static void check(int condition, const char *what)
+{
+  if (!condition)
+  {
+    printf("%s\n", what);
+    ++failures;
+  }
+}
+
+static long file_size(const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return -1;
+  fseek(file, 0, SEEK_END);
+  long ret = ftell(file);
+  fclose(file);
+  return ret;
+}
+
+int main(void)
+{
+  static uint8_t chart[FIXTURE_IIDX_1_MAX_SIZE];
+  iidx_1_note_counts expected;
+  uint32_t length = fixture_build_iidx_1(3, chart, &expected);
+
+  ifs_archive *archive = NULL;
+  if (fixture_make_directories("archive") || fixture_write_ifs("archive/95000.ifs", "95000", chart, length) ||
+      ifs_open("archive/95000.ifs", &archive) != IFS_NO_ERROR)
+  {
+    printf("failed to open the test ifs\n");
+    return 1;
+  }
+
+  // entries come back sorted, find hands out the same entries as get.
+  check(ifs_get_entry_count(archive) == 2, "wrong entry count");
+  const ifs_entry *first = ifs_get_entry(archive, 0);
+  const ifs_entry *second = ifs_get_entry(archive, 1);
+  check(first != NULL && strcmp(first->path, "imgfs/_95000/_95000_E1") == 0 && first->size == length,
+        "the chart isn't the first entry");
+  check(second != NULL && strcmp(second->path, "imgfs/_95000/_95000_E2") == 0 && second->size == 77,
+        "the dummy isn't the second entry");
+  check(ifs_get_entry(archive, 2) == NULL, "an entry past the end was returned");
+  check(ifs_find_entry(archive, "imgfs/_95000/_95000_E1") == first, "find returned another chart entry");
+  check(ifs_find_entry(archive, "imgfs/_95000/_95000_E2") == second, "find returned another dummy entry");
+  check(ifs_find_entry(archive, "imgfs/_95000/_95000_E3") == NULL, "found an entry that doesn't exist");
+  check(ifs_find_entry(archive, NULL) == NULL && ifs_find_entry(NULL, "imgfs") == NULL, "found an entry without args");
+  if (first == NULL || second == NULL)
+  {
+    ifs_close(archive);
+    printf("%d failures\n", failures);
+    return 1;
+  }
+
+  // the chart sits right behind the 77 byte dummy.
+  check(first->offset == second->offset + 77, "the chart isn't stored behind the dummy");
+
+  // reads start offset bytes into the entry.
+  uint8_t buffer[64];
+  check(ifs_read_entry(archive, first, 100, buffer, sizeof(buffer)) == IFS_NO_ERROR &&
+        memcmp(buffer, chart + 100, sizeof(buffer)) == 0, "a read at an offset returned the wrong bytes");
+  check(ifs_read_entry(archive, first, length - 8, buffer, 8) == IFS_NO_ERROR &&
+        memcmp(buffer, chart + length - 8, 8) == 0, "a read of the last bytes returned the wrong bytes");
+  check(ifs_read_entry(archive, first, length, buffer, 0) == IFS_NO_ERROR, "an empty read at the end failed");
+
+  // ranges that leave the entry are rejected, also when offset + size wraps around.
+  check(ifs_read_entry(archive, first, length + 1, buffer, 0) == IFS_INVALID_PARAM, "an offset past the end was read");
+  check(ifs_read_entry(archive, first, length - 4, buffer, 8) == IFS_INVALID_PARAM, "a read past the end succeeded");
+  check(ifs_read_entry(archive, first, 8, buffer, UINT32_MAX) == IFS_INVALID_PARAM, "a wrapping read succeeded");
+  check(ifs_read_entry(archive, first, 0, NULL, 8) == IFS_INVALID_PARAM, "a read without a buffer succeeded");
+
+  // the mapping, where there is one, holds the same bytes.
+  const uint8_t *data = NULL;
+  ifs_error e = ifs_map_entry(archive, first, &data);
+  check(e == IFS_NO_ERROR || e == IFS_MAP_FAILED, "mapping failed with an unexpected error");
+  check(e != IFS_NO_ERROR || memcmp(data, chart, length) == 0, "the mapping holds the wrong bytes");
+  check(ifs_map_entry(archive, first, NULL) == IFS_INVALID_PARAM, "mapping without an out pointer succeeded");
+
+  uint64_t size = 0;
+  int64_t mtime = 0;
+  ifs_get_file_stamp(archive, &size, &mtime);
+  check((long) size == file_size("archive/95000.ifs") && mtime > 0, "wrong file stamp");
+  ifs_get_file_stamp(archive, NULL, NULL);
+  ifs_get_file_stamp(NULL, &size, &mtime);
+
+  ifs_close(archive);
+
+  printf("%d failures\n", failures);
+  return failures != 0;
+}
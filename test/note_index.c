@@ -0,0 +1,144 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../note_index.h"
+
+// checks range and top-k queries against a brute-force pass over the songs, with bounds on and around the note
+// counts that are in the index, slots nobody has a chart in and songs whose charts have no notes.
+
+#define SONG_COUNT 5000
+#define MAX_NOTES 300
+
+static iidx_music_note_counts songs[SONG_COUNT];
+static uint32_t expected[SONG_COUNT], top[SONG_COUNT + 1];
+static int failures;
+
+static int sort_chart;
+
+static int compare_ids(const void *a, const void *b)
+{
+  uint32_t id_a = *(const uint32_t*) a, id_b = *(const uint32_t*) b;
+  int notes_a = songs[id_a].note_counts.charts[sort_chart], notes_b = songs[id_b].note_counts.charts[sort_chart];
+  if (notes_a != notes_b)
+    return notes_a < notes_b ? -1 : 1;
+  return id_a < id_b ? -1 : id_a > id_b;
+}
+
+// every song with a note count in [min_notes, max_notes], in the order the index promises.
+static uint32_t brute_force_range(iidx_1_chart chart, uint32_t count, int min_notes, int max_notes)
+{
+  uint32_t ret = 0;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    int notes = songs[i].note_counts.charts[chart];
+    if (notes > 0 && notes >= min_notes && notes <= max_notes)
+      expected[ret++] = i;
+  }
+  sort_chart = chart;
+  qsort(expected, ret, sizeof(uint32_t), compare_ids);
+  return ret;
+}
+
+static void check_range(const note_index *index, iidx_1_chart chart, uint32_t count, int min_notes, int max_notes)
+{
+  const uint32_t *ids;
+  uint32_t id_count;
+  uint32_t expected_count = brute_force_range(chart, count, min_notes, max_notes);
+  if (note_index_range(index, chart, min_notes, max_notes, &ids, &id_count) ||
+      id_count != expected_count || (id_count > 0 && memcmp(ids, expected, id_count * sizeof(uint32_t)) != 0))
+  {
+    printf("chart %d range [%d, %d] doesn't match\n", chart, min_notes, max_notes);
+    ++failures;
+  }
+}
+
+static void check_top(const note_index *index, iidx_1_chart chart, uint32_t count, uint32_t k)
+{
+  // the top k are the end of the ascending order, reversed.
+  uint32_t expected_count = brute_force_range(chart, count, INT_MIN, INT_MAX);
+  uint32_t written = k < expected_count ? k : expected_count;
+  top[written] = 0xffffffff;
+  int ret = note_index_top(index, chart, k, top);
+  int mismatch = ret != (int) written || top[written] != 0xffffffff;
+  for (uint32_t i = 0; !mismatch && i < written; ++i)
+    mismatch = top[i] != expected[expected_count - 1 - i];
+  if (mismatch)
+  {
+    printf("chart %d top %u doesn't match\n", chart, k);
+    ++failures;
+  }
+}
+
+static void check_index(uint32_t count)
+{
+  note_index *index = note_index_create(songs, count);
+  if (index == NULL)
+  {
+    printf("failed to index %u songs\n", count);
+    ++failures;
+    return;
+  }
+
+  for (int chart = 0; chart < IIDX_1_MAX_CHART_COUNT; ++chart)
+  {
+    iidx_1_chart slot = (iidx_1_chart) chart;
+    if (note_index_get_chart_count(index, slot) != brute_force_range(slot, count, INT_MIN, INT_MAX))
+    {
+      printf("chart %d indexes the wrong number of songs\n", chart);
+      ++failures;
+    }
+
+    // bounds exactly on note counts that exist, just next to them, reversed, and the whole range.
+    for (int notes = -1; notes <= MAX_NOTES + 1; notes += 7)
+    {
+      check_range(index, slot, count, notes, notes);
+      check_range(index, slot, count, notes, notes + 13);
+      check_range(index, slot, count, notes + 1, notes - 1);
+    }
+    check_range(index, slot, count, 0, 0);
+    check_range(index, slot, count, 1, 1);
+    check_range(index, slot, count, MAX_NOTES, MAX_NOTES);
+    check_range(index, slot, count, INT_MIN, INT_MAX);
+    check_range(index, slot, count, INT_MAX, INT_MAX);
+
+    uint32_t ks[] = {0, 1, 10, 1000, SONG_COUNT};
+    for (uint32_t i = 0; i < sizeof(ks) / sizeof(ks[0]); ++i)
+      check_top(index, slot, count, ks[i]);
+  }
+
+  note_index_destroy(index);
+}
+
+int main(void)
+{
+  // few distinct note counts, so every count is shared by many songs and ties decide the order.
+  uint32_t seed = 0x1b873593;
+  for (uint32_t i = 0; i < SONG_COUNT; ++i)
+  {
+    snprintf(songs[i].music_id, sizeof(songs[i].music_id), "%05u", 10000 + i);
+    for (int chart = 0; chart < IIDX_1_MAX_CHART_COUNT; ++chart)
+    {
+      seed = seed * 1103515245 + 12345;
+      uint32_t roll = (seed >> 16) % 100;
+      // 10% failed, 10% empty, the rest notes. slot 4 is empty everywhere, slot 5 only ever failed.
+      int notes = roll < 10 ? -1 : roll < 20 ? 0 : (int) ((seed >> 8) % MAX_NOTES) + 1;
+      if (chart == 4)
+        notes = 0;
+      else if (chart == 5)
+        notes = -1;
+      songs[i].note_counts.charts[chart] = notes;
+    }
+  }
+
+  // a song whose charts have no notes at all is never returned.
+  memset(&songs[17].note_counts, 0, sizeof(songs[17].note_counts));
+
+  check_index(SONG_COUNT);
+  check_index(1);
+  check_index(0);
+
+  printf("%d failures\n", failures);
+  return failures != 0;
+}
@@ -0,0 +1,129 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../allocator.h"
+#include "../epoch.h"
+#include "../note_table.h"
+#include "../thread.h"
+
+// publishes and looks up songs, checks replaced snapshots are only freed once no reader can see them and that threads
+// coming and going reuse their reader records instead of piling up new ones.
+
+#define READER_THREAD_COUNT 4
+#define READER_ROUNDS 50
+#define FINDS_PER_READER 100
+
+static int failures;
+static atomic_int reader_failures;
+static note_table *table;
+
+static void check(int condition, const char *what)
+{
+  if (!condition)
+  {
+    printf("%s\n", what);
+    ++failures;
+  }
+}
+
+static void set_entry(iidx_music_note_counts *entry, const char *music_id, int notes)
+{
+  memset(entry, 0, sizeof(*entry));
+  strcpy(entry->music_id, music_id);
+  for (int i = 0; i < IIDX_1_MAX_CHART_COUNT; ++i)
+    entry->note_counts.charts[i] = notes + i;
+}
+
+static int find_notes(const char *music_id)
+{
+  iidx_1_note_counts counts;
+  return note_table_find(table, music_id, &counts) == 0 ? counts.charts[0] : -1;
+}
+
+static uint64_t live_bytes(void)
+{
+  allocator_stats stats;
+  return allocator_get_stats(ALLOCATOR_STAGE_COUNT, &stats) == 0 ? stats.live_bytes : 0;
+}
+
+static thread_result THREAD_CALL find_songs(void *arg)
+{
+  (void) arg;
+  for (int i = 0; i < FINDS_PER_READER; ++i)
+  {
+    if (find_notes("96001") != 100)
+      atomic_fetch_add(&reader_failures, 1);
+  }
+  return 0;
+}
+
+int main(void)
+{
+  if (allocator_set_accounting(NULL))
+    return 1;
+
+  table = note_table_create();
+  if (table == NULL)
+  {
+    printf("failed to create the table\n");
+    return 1;
+  }
+  check(find_notes("96000") == -1 && note_table_get_count(table) == 0 && note_table_get_generation(table) == 0,
+        "an empty table isn't empty");
+
+  // entries are sorted on publish, every one of them is found.
+  iidx_music_note_counts entries[3];
+  set_entry(&entries[0], "96002", 300);
+  set_entry(&entries[1], "96000", 100);
+  set_entry(&entries[2], "96001", 200);
+  check(note_table_publish(table, entries, 3) == 0, "failed to publish");
+  check(find_notes("96000") == 100 && find_notes("96001") == 200 && find_notes("96002") == 300,
+        "published songs weren't found");
+  check(find_notes("96003") == -1, "found a song that wasn't published");
+  check(note_table_get_count(table) == 3 && note_table_get_generation(table) == 1, "wrong count or generation");
+
+  // a new publish replaces the table as a whole.
+  set_entry(&entries[0], "96001", 100);
+  check(note_table_publish(table, entries, 1) == 0, "failed to republish");
+  check(find_notes("96001") == 100 && find_notes("96000") == -1 && find_notes("96002") == -1,
+        "the old snapshot is still visible");
+  check(note_table_get_count(table) == 1 && note_table_get_generation(table) == 2, "wrong count or generation");
+
+  // without readers the replaced snapshot is freed right away, so publishing the same songs doesn't grow memory.
+  uint64_t settled = live_bytes();
+  check(note_table_publish(table, entries, 1) == 0 && live_bytes() == settled, "a replaced snapshot was kept");
+
+  // a reader in its section keeps the snapshot it may have loaded alive until it leaves.
+  epoch_record *record = epoch_enter();
+  check(record != NULL && note_table_publish(table, entries, 1) == 0 && live_bytes() > settled,
+        "a snapshot was freed under a reader");
+  if (record != NULL)
+    epoch_exit(record);
+  check(note_table_publish(table, entries, 1) == 0 && live_bytes() == settled,
+        "the snapshot wasn't freed after the reader left");
+
+  // the main thread holds one record, every round's threads take over the records the last round left behind.
+  for (int round = 0; round < READER_ROUNDS; ++round)
+  {
+    thread threads[READER_THREAD_COUNT];
+    for (int i = 0; i < READER_THREAD_COUNT; ++i)
+    {
+      if (thread_create(&threads[i], find_songs, NULL))
+      {
+        printf("failed to create a thread\n");
+        return 1;
+      }
+    }
+    check(note_table_publish(table, entries, 1) == 0, "failed to publish under readers");
+    for (int i = 0; i < READER_THREAD_COUNT; ++i)
+      thread_join(threads[i]);
+  }
+  check(atomic_load(&reader_failures) == 0, "a reader thread didn't find 96001");
+  check(epoch_get_record_count() <= READER_THREAD_COUNT + 1, "exited threads left their records behind");
+
+  note_table_destroy(table);
+
+  printf("%d failures\n", failures);
+  return failures != 0;
+}
@@ -0,0 +1,112 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../iidx_note_count.h"
+#include "../thread.h"
+#include "fixture.h"
+
+// layers a patch root over a data root and checks every song resolves to the file the priority rules pick, also while
+// the roots are being replaced under running queries.
+
+#define QUERY_THREAD_COUNT 4
+#define ROOT_SWAP_COUNT 200
+
+static int failures;
+static atomic_int swapping;
+static atomic_int query_failures;
+static iidx_1_note_counts swapped_expected;
+
+static thread_result THREAD_CALL query_while_swapping(void *arg)
+{
+  (void) arg;
+
+  // 90004 resolves to the same file in every index the main thread swaps in.
+  while (atomic_load(&swapping))
+  {
+    iidx_1_note_counts counts;
+    if (get_music_note_counts("90004", &counts) != 0 || memcmp(&counts, &swapped_expected, sizeof(counts)) != 0)
+      atomic_fetch_add(&query_failures, 1);
+  }
+
+  return 0;
+}
+
+static void check_song(const char *music_id, const iidx_1_note_counts *expected)
+{
+  iidx_1_note_counts counts;
+  int ret = get_music_note_counts(music_id, &counts);
+  if (expected == NULL ? ret != -1 : ret != 0 || memcmp(&counts, expected, sizeof(counts)) != 0)
+  {
+    printf("%s resolved to the wrong file\n", music_id);
+    ++failures;
+  }
+}
+
+int main(void)
+{
+  iidx_1_note_counts patch_extracted, patch_ifs, data_ifs, data_extracted, data_shadowed, both_extracted, both_ifs;
+  int failed = 0;
+
+  // a patch folder without a .1 (only the keysounds) must fall through to the ifs below it.
+  failed |= fixture_make_directories("roots/patch/90003");
+  FILE *file = fopen("roots/patch/90003/90003.2dx", "wb");
+  failed |= file == NULL || fclose(file) != 0;
+  failed |= fixture_write_song("roots/data", "90003", 3, 1, &data_ifs);
+
+  // earlier roots win, whatever the format.
+  failed |= fixture_write_song("roots/patch", "90004", 40, 0, &patch_extracted);
+  failed |= fixture_write_song("roots/data", "90004", 4, 1, &data_shadowed);
+  failed |= fixture_write_song("roots/patch", "90005", 50, 1, &patch_ifs);
+  failed |= fixture_write_song("roots/data", "90005", 5, 0, &data_shadowed);
+
+  // within a root the extracted folder wins over the ifs.
+  failed |= fixture_write_song("roots/data", "90006", 6, 0, &both_extracted);
+  failed |= fixture_write_song("roots/data", "90006", 60, 1, &both_ifs);
+  failed |= fixture_write_song("roots/data", "90008", 8, 0, &data_extracted);
+  if (failed)
+  {
+    printf("failed to write the test songs\n");
+    return 1;
+  }
+
+  const char *roots[] = {"roots/patch", "roots/data"};
+  if (set_music_roots(roots, 2))
+  {
+    printf("failed to index the roots\n");
+    return 1;
+  }
+
+  check_song("90003", &data_ifs);
+  check_song("90004", &patch_extracted);
+  check_song("90005", &patch_ifs);
+  check_song("90006", &both_extracted);
+  check_song("90008", &data_extracted);
+  check_song("90007", NULL);
+
+  // queries don't take a lock on the index, old indexes must stay alive until they're done with them.
+  swapped_expected = patch_extracted;
+  atomic_store(&swapping, 1);
+  thread threads[QUERY_THREAD_COUNT];
+  int started = 0;
+  while (started < QUERY_THREAD_COUNT && thread_create(&threads[started], query_while_swapping, NULL) == 0)
+    ++started;
+  const char *patch_root[] = {"roots/patch"};
+  for (int i = 0; i < ROOT_SWAP_COUNT; ++i)
+  {
+    if (i % 2 ? set_music_roots(roots, 2) : set_music_roots(patch_root, 1))
+      atomic_fetch_add(&query_failures, 1);
+  }
+  atomic_store(&swapping, 0);
+  for (int i = 0; i < started; ++i)
+    thread_join(threads[i]);
+  if (started == 0 || atomic_load(&query_failures) != 0)
+  {
+    printf("%d queries failed while the roots were replaced\n", atomic_load(&query_failures));
+    ++failures;
+  }
+
+  set_music_roots(NULL, 0);
+  printf("%d failures\n", failures);
+  return failures > 0;
+}
@@ -0,0 +1,91 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../shm_note_table.h"
+
+// publishes, attaches, republishes and finds through a shared memory table, including a publish that has to get past
+// the segment a crashed publisher left behind.
+
+static int failures;
+
+static void check(int condition, const char *what)
+{
+  if (!condition)
+  {
+    printf("%s\n", what);
+    ++failures;
+  }
+}
+
+static void make_entry(iidx_music_note_counts *out_entry, const char *music_id, int base)
+{
+  memset(out_entry, 0, sizeof(*out_entry));
+  strcpy(out_entry->music_id, music_id);
+  for (int i = 0; i < IIDX_1_MAX_CHART_COUNT; ++i)
+    out_entry->note_counts.charts[i] = base + i;
+}
+
+static int find_chart(shm_note_table *table, const char *music_id)
+{
+  const iidx_1_note_counts *counts = shm_note_table_find(table, music_id);
+  return counts != NULL ? counts->charts[0] : -1;
+}
+
+int main(void)
+{
+  char name[64];
+  char leftover_name[80];
+  snprintf(name, sizeof(name), "/note_counter_test_%d", (int) getpid());
+  shm_note_table_unlink(name);
+
+  iidx_music_note_counts entries[2];
+  make_entry(&entries[0], "01001", 100);
+  make_entry(&entries[1], "01000", 200);
+  check(shm_note_table_publish(name, entries, 2) == 0, "first publish failed");
+
+  shm_note_table *table = shm_note_table_attach(name);
+  if (table == NULL)
+  {
+    printf("failed to attach\n");
+    shm_note_table_unlink(name);
+    return 1;
+  }
+  check(find_chart(table, "01000") == 200 && find_chart(table, "01001") == 100, "wrong first generation entries");
+  check(find_chart(table, "01002") == -1, "found a song that was never published");
+  check(shm_note_table_get_generation(table) == 1 && shm_note_table_get_count(table) == 2, "wrong first generation");
+
+  // readers switch over on their next find.
+  make_entry(&entries[0], "01002", 300);
+  check(shm_note_table_publish(name, entries, 1) == 0, "second publish failed");
+  check(find_chart(table, "01002") == 300 && find_chart(table, "01000") == -1, "wrong second generation entries");
+  check(shm_note_table_get_generation(table) == 2 && shm_note_table_get_count(table) == 1, "wrong second generation");
+
+  // a publisher that died after creating generation 3 but before publishing it.
+  snprintf(leftover_name, sizeof(leftover_name), "%s.3", name);
+  int fd = shm_open(leftover_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  check(fd >= 0, "failed to create the leftover segment");
+  if (fd >= 0)
+    close(fd);
+
+  make_entry(&entries[0], "01003", 400);
+  check(shm_note_table_publish(name, entries, 1) == 0, "publish after a crashed publisher failed");
+  check(find_chart(table, "01003") == 400, "wrong entries after a crashed publisher");
+  check(shm_note_table_get_generation(table) == 4, "the leftover generation wasn't skipped");
+  fd = shm_open(leftover_name, O_RDONLY, 0);
+  check(fd < 0, "the leftover segment wasn't removed");
+  if (fd >= 0)
+    close(fd);
+
+  // and publishing keeps working from there.
+  make_entry(&entries[0], "01004", 500);
+  check(shm_note_table_publish(name, entries, 1) == 0, "publish after recovering failed");
+  check(find_chart(table, "01004") == 500 && shm_note_table_get_generation(table) == 5, "wrong entries after recovering");
+
+  shm_note_table_detach(table);
+  shm_note_table_unlink(name);
+  printf("%d failures\n", failures);
+  return failures > 0;
+}
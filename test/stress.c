@@ -0,0 +1,178 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../allocator.h"
+#include "../iidx_note_count.h"
+#include "../note_table.h"
+#include "../thread.h"
+#include "../trace.h"
+#include "fixture.h"
+
+// hammers the query api and the note table from many threads at once, run it under tsan to check the library is reentrant.
+// writes its own songs into data/sound/ of the working directory, even ids extracted and odd ids as an ifs.
+// everything runs on the accounting allocator, which also checks the chart and scan stages free all they allocate.
+
+#define SONG_COUNT 16
+#define THREAD_COUNT 32
+#define ITERATIONS 200
+#define DENSITY_WINDOW 1000
+
+typedef struct
+{
+  char music_id[IIDX_MUSIC_ID_SIZE];
+  iidx_1_note_counts expected;
+} song;
+
+static song songs[SONG_COUNT];
+static const char *music_ids[SONG_COUNT];
+static note_table *table;
+static atomic_int failures;
+
+static uint32_t next_random(uint32_t *state)
+{
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 8;
+}
+
+static int write_songs(void)
+{
+  for (uint32_t i = 0; i < SONG_COUNT; ++i)
+  {
+    song *s = &songs[i];
+    snprintf(s->music_id, sizeof(s->music_id), "%05u", 90000 + i);
+    if (fixture_write_song("data/sound", s->music_id, i + 1, i % 2, &s->expected))
+      return -1;
+  }
+
+  return 0;
+}
+
+static void check(int condition, const char *what, const song *s)
+{
+  if (!condition && atomic_fetch_add(&failures, 1) < 10)
+    printf("%s mismatch for %s\n", what, s->music_id);
+}
+
+static thread_result THREAD_CALL query_worker(void *arg)
+{
+  uint32_t state = (uint32_t) (uintptr_t) arg;
+  chart_cache *cache = chart_cache_create(64);
+
+  for (int i = 0; i < ITERATIONS; ++i)
+  {
+    const song *s = &songs[next_random(&state) % SONG_COUNT];
+    iidx_1_chart chart = (iidx_1_chart) (next_random(&state) % IIDX_1_MAX_CHART_COUNT);
+    iidx_1_note_counts counts;
+    iidx_1_note_densities densities;
+
+    switch (next_random(&state) % 8)
+    {
+      case 0:
+        check(get_music_note_counts(s->music_id, &counts) == 0 &&
+              memcmp(&counts, &s->expected, sizeof(counts)) == 0, "note counts", s);
+        break;
+      case 1:
+        check(get_chart_note_count(s->music_id, chart) == s->expected.charts[chart], "chart note count", s);
+        break;
+      case 2:
+        check(get_music_note_counts_cached(s->music_id, cache, &counts) == 0 &&
+              memcmp(&counts, &s->expected, sizeof(counts)) == 0, "cached note counts", s);
+        break;
+      case 3:
+        check(get_music_note_densities(s->music_id, DENSITY_WINDOW, &densities) == 0 &&
+              densities.charts[chart].note_count == s->expected.charts[chart], "note densities", s);
+        break;
+      case 4:
+        check(note_table_find(table, s->music_id, &counts) == 0 &&
+              memcmp(&counts, &s->expected, sizeof(counts)) == 0, "note table", s);
+        break;
+      case 5:
+        // swap in a new snapshot while everyone else keeps reading.
+        check(note_table_rebuild(table, music_ids, SONG_COUNT) == 0 && note_table_get_count(table) == SONG_COUNT,
+              "note table rebuild", s);
+        break;
+      case 6:
+        check(get_music_note_counts_streaming(s->music_id, &counts) == 0 &&
+              memcmp(&counts, &s->expected, sizeof(counts)) == 0, "streamed note counts", s);
+        break;
+      default:
+      {
+        // flip the buffer cache between disabled, tight and roomy budgets underneath everyone else.
+        static const size_t budgets[] = {0, 4096, 1 << 16, 1 << 24};
+        set_iidx_1_cache_budget(budgets[next_random(&state) % 4]);
+        if (next_random(&state) % 8 == 0)
+          clear_iidx_1_cache();
+        break;
+      }
+    }
+  }
+
+  chart_cache_destroy(cache);
+  return 0;
+}
+
+static int check_stage_freed(allocator_stage stage, const char *name)
+{
+  allocator_stats stats;
+  if (allocator_get_stats(stage, &stats))
+    return -1;
+
+  printf("%s: %llu bytes peak, %llu allocations\n", name, (unsigned long long) stats.peak_bytes,
+         (unsigned long long) stats.allocation_count);
+  if (stats.live_bytes != 0 || stats.allocation_count != stats.free_count)
+  {
+    printf("%s leaked %llu bytes\n", name, (unsigned long long) stats.live_bytes);
+    return -1;
+  }
+  return 0;
+}
+
+int main(void)
+{
+  if (allocator_set_accounting(NULL))
+  {
+    printf("failed to enable allocation accounting\n");
+    return 1;
+  }
+
+  if (write_songs())
+  {
+    printf("failed to write the test songs\n");
+    return 1;
+  }
+
+  table = note_table_create();
+  for (uint32_t i = 0; i < SONG_COUNT; ++i)
+    music_ids[i] = songs[i].music_id;
+  if (table == NULL || note_table_rebuild(table, music_ids, SONG_COUNT))
+  {
+    printf("failed to build the note table\n");
+    return 1;
+  }
+
+  trace_start(1024);
+
+  thread threads[THREAD_COUNT];
+  uint32_t started = 0;
+  while (started < THREAD_COUNT && thread_create(&threads[started], query_worker, (void*) (uintptr_t) (started + 1)) == 0)
+    ++started;
+  for (uint32_t i = 0; i < started; ++i)
+    thread_join(threads[i]);
+
+  trace_stop(NULL);
+  set_iidx_1_cache_budget(0);
+  note_table_destroy(table);
+
+  if (started < THREAD_COUNT)
+  {
+    printf("only started %u of %d threads\n", started, THREAD_COUNT);
+    return 1;
+  }
+
+  int failed = atomic_load(&failures);
+  if (check_stage_freed(ALLOCATOR_STAGE_CHART, "chart") || check_stage_freed(ALLOCATOR_STAGE_SCAN, "scan"))
+    ++failed;
+  printf("%d threads, %d queries each, %d failures\n", THREAD_COUNT, ITERATIONS, failed);
+  return failed > 0;
+}
@@ -0,0 +1,140 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../thread.h"
+#include "../trace.h"
+
+// a wrapped ring must not write ends whose begin was overwritten, and events recorded while no trace is running
+// must not show up in a later one. stopping a trace while other threads record must not free a buffer under them,
+// the sanitizer builds catch that.
+
+#define RECORDING_THREAD_COUNT 4
+#define RESTART_COUNT 200
+
+static int failures;
+static atomic_int recording;
+static atomic_uint spans;
+
+static char *read_text(const char *path)
+{
+  static char text[1 << 16];
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return NULL;
+  size_t length = fread(text, 1, sizeof(text) - 1, file);
+  fclose(file);
+  text[length] = 0;
+  return text;
+}
+
+static void check(int condition, const char *what)
+{
+  if (!condition)
+  {
+    printf("%s\n", what);
+    ++failures;
+  }
+}
+
+// walks the events in file order and returns how many there are, -1 if an end comes without an open span.
+static int count_balanced_events(const char *text, int *out_begins)
+{
+  int depth = 0, count = 0;
+  *out_begins = 0;
+  for (const char *cur = strstr(text, "\"ph\":\""); cur != NULL; cur = strstr(cur + 1, "\"ph\":\""))
+  {
+    char phase = cur[6];
+    ++count;
+    if (phase == 'B')
+    {
+      ++depth;
+      ++*out_begins;
+    }
+    else if (depth-- == 0)
+      return -1;
+  }
+  return count;
+}
+
+static thread_result THREAD_CALL record_until_done(void *arg)
+{
+  (void) arg;
+  while (atomic_load(&recording))
+  {
+    TRACE_BEGIN("busy");
+    TRACE_END("busy");
+    atomic_fetch_add(&spans, 1);
+  }
+  return 0;
+}
+
+int main(void)
+{
+  check(trace_stop("unused.json") == -1, "stopping without a trace succeeded");
+
+  // 22 events into a ring of 8: the outer begin and the first inner begins are overwritten.
+  if (trace_start(8))
+  {
+    printf("failed to start the trace\n");
+    return 1;
+  }
+  trace_begin("outer", -1);
+  for (int i = 0; i < 10; ++i)
+  {
+    trace_begin("inner", i);
+    trace_end("inner");
+  }
+  trace_end("outer");
+  check(trace_stop("wrapped.json") == 0, "failed to write the wrapped trace");
+
+  int begins;
+  const char *text = read_text("wrapped.json");
+  int count = text != NULL ? count_balanced_events(text, &begins) : -1;
+  check(count == 6 && begins == 3, "the wrapped trace holds unmatched ends");
+  check(text != NULL && strstr(text, "outer") == NULL, "the outer end was written without its begin");
+
+  // recording between traces is dropped instead of registering a buffer nobody collects.
+  trace_begin("stray", -1);
+  trace_end("stray");
+  if (trace_start(8))
+  {
+    printf("failed to restart the trace\n");
+    return 1;
+  }
+  trace_begin("second", -1);
+  trace_end("second");
+  check(trace_stop("second.json") == 0, "failed to write the second trace");
+  text = read_text("second.json");
+  check(text != NULL && strstr(text, "second") != NULL, "the second trace lost its events");
+  check(text != NULL && strstr(text, "stray") == NULL, "events from between traces were written");
+
+  // restart the trace under threads that keep recording.
+  thread threads[RECORDING_THREAD_COUNT];
+  atomic_store(&recording, 1);
+  for (int i = 0; i < RECORDING_THREAD_COUNT; ++i)
+  {
+    if (thread_create(&threads[i], record_until_done, NULL))
+    {
+      printf("failed to create a thread\n");
+      return 1;
+    }
+  }
+  for (int i = 0; i < RESTART_COUNT; ++i)
+  {
+    check(trace_start(64) == 0, "failed to start a trace under recording threads");
+
+    // stop only once the threads are recording into this trace.
+    unsigned started = atomic_load(&spans);
+    while (atomic_load(&spans) - started < 2 * RECORDING_THREAD_COUNT)
+      thread_yield();
+    check(trace_stop(NULL) == -1, "a trace without a path was written");
+  }
+  atomic_store(&recording, 0);
+  for (int i = 0; i < RECORDING_THREAD_COUNT; ++i)
+    thread_join(threads[i]);
+
+  printf("%d failures\n", failures);
+  return failures != 0;
+}
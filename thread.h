@@ -0,0 +1,145 @@
+#ifndef THREAD_H_
+#define THREAD_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// minimal native threading wrappers, pthreads everywhere but windows.
+// thread functions are declared as "thread_result THREAD_CALL function(void *arg)" and return 0.
+// THREAD_LOCAL marks variables with one instance per thread, thread_yield gives up the rest of the time slice.
+// a thread_key holds one value per thread and calls its destructor, declared as "void THREAD_KEY_CALL destroy(void*)",
+// with every non-NULL value when its thread exits.
+
+#ifdef _WIN32
+  #include <windows.h>
+
+  typedef HANDLE thread;
+  typedef DWORD thread_result;
+  #define THREAD_CALL WINAPI
+  #define THREAD_LOCAL __declspec(thread)
+
+  // fiber local storage, unlike tls slots it calls a destructor when the thread exits.
+  typedef DWORD thread_key;
+  #define THREAD_KEY_CALL NTAPI
+
+  typedef SRWLOCK mutex;
+  #define MUTEX_INITIALIZER SRWLOCK_INIT
+
+  static inline int thread_create(thread *t, thread_result (THREAD_CALL *function)(void*), void *arg)
+  {
+    *t = CreateThread(NULL, 0, function, arg, 0, NULL);
+    return *t == NULL ? -1 : 0;
+  }
+
+  static inline void thread_join(thread t)
+  {
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+  }
+
+  static inline void mutex_init(mutex *m)
+  {
+    InitializeSRWLock(m);
+  }
+
+  static inline void mutex_destroy(mutex *m)
+  {
+    (void) m;
+  }
+
+  static inline void mutex_lock(mutex *m)
+  {
+    AcquireSRWLockExclusive(m);
+  }
+
+  static inline void mutex_unlock(mutex *m)
+  {
+    ReleaseSRWLockExclusive(m);
+  }
+
+  static inline void thread_yield(void)
+  {
+    SwitchToThread();
+  }
+
+  static inline int thread_key_create(thread_key *key, void (THREAD_KEY_CALL *destroy)(void*))
+  {
+    *key = FlsAlloc(destroy);
+    return *key == FLS_OUT_OF_INDEXES ? -1 : 0;
+  }
+
+  static inline int thread_key_set(thread_key key, void *value)
+  {
+    return FlsSetValue(key, value) ? 0 : -1;
+  }
+#else
+  #include <pthread.h>
+  #include <sched.h>
+
+  typedef pthread_t thread;
+  typedef void *thread_result;
+  #define THREAD_CALL
+
+  typedef pthread_key_t thread_key;
+  #define THREAD_KEY_CALL
+  #ifdef __cplusplus
+    #define THREAD_LOCAL thread_local
+  #else
+    #define THREAD_LOCAL _Thread_local
+  #endif
+
+  typedef pthread_mutex_t mutex;
+  #define MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+
+  static inline int thread_create(thread *t, thread_result (THREAD_CALL *function)(void*), void *arg)
+  {
+    return pthread_create(t, NULL, function, arg) == 0 ? 0 : -1;
+  }
+
+  static inline void thread_join(thread t)
+  {
+    pthread_join(t, NULL);
+  }
+
+  static inline void mutex_init(mutex *m)
+  {
+    pthread_mutex_init(m, NULL);
+  }
+
+  static inline void mutex_destroy(mutex *m)
+  {
+    pthread_mutex_destroy(m);
+  }
+
+  static inline void mutex_lock(mutex *m)
+  {
+    pthread_mutex_lock(m);
+  }
+
+  static inline void mutex_unlock(mutex *m)
+  {
+    pthread_mutex_unlock(m);
+  }
+
+  static inline void thread_yield(void)
+  {
+    sched_yield();
+  }
+
+  static inline int thread_key_create(thread_key *key, void (THREAD_KEY_CALL *destroy)(void*))
+  {
+    return pthread_key_create(key, destroy) == 0 ? 0 : -1;
+  }
+
+  static inline int thread_key_set(thread_key key, void *value)
+  {
+    return pthread_setspecific(key, value) == 0 ? 0 : -1;
+  }
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // THREAD_H_
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../iidx_note_count.h"
+
+#define MAX_MUSIC_IDS 0x10000
+
+static void usage(void)
+{
+  printf("usage: extract [-c] [-j threads] [music_id...]\n");
+  printf("  extracts data/sound/<id>.ifs into data/sound/<id>/, reading ids from stdin when none are given.\n");
+  printf("  -c  only extract the .1 charts\n");
+  printf("  -j  number of threads (default 8)\n");
+}
+
+int main(int argc, char **argv)
+{
+  int charts_only = 0;
+  uint32_t thread_count = 8;
+  static char *music_ids[MAX_MUSIC_IDS];
+  uint32_t count = 0;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "-c") == 0)
+      charts_only = 1;
+    else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+      thread_count = (uint32_t) strtoul(argv[++i], NULL, 10);
+    else if (argv[i][0] == '-')
+    {
+      usage();
+      return 1;
+    }
+    else if (count < MAX_MUSIC_IDS)
+      music_ids[count++] = argv[i];
+  }
+
+  // read ids from stdin, one per line.
+  char line[128];
+  if (count == 0)
+  {
+    while (count < MAX_MUSIC_IDS && fgets(line, sizeof(line), stdin) != NULL)
+    {
+      line[strcspn(line, "\r\n")] = 0;
+      if (line[0] != 0)
+      {
+        music_ids[count] = (char*) malloc(strlen(line) + 1);
+        strcpy(music_ids[count++], line);
+      }
+    }
+  }
+
+  int failures = extract_music((const char**) music_ids, count, charts_only, thread_count);
+  printf("extracted %u songs, %d failed\n", count - failures, failures);
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+#include "trace.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <time.h>
+#endif
+
+#include "allocator.h"
+#include "thread.h"
+
+typedef struct
+{
+  uint64_t timestamp; // nanoseconds.
+  const char *name;
+  int64_t value;
+  char phase; // 'B' or 'E'.
+} trace_event;
+
+// one per recording thread, only ever written by its owner.
+typedef struct trace_buffer_s
+{
+  struct trace_buffer_s *next;
+  uint32_t thread_id;
+  uint32_t capacity;
+  atomic_uint_fast64_t written; // total events recorded, the ring holds the last capacity of them.
+  trace_event events[];
+} trace_buffer;
+
+static atomic_int enabled;
+static atomic_uint generation;
+static atomic_uint events_per_thread;
+static atomic_uint next_thread_id;
+
+// every thread counts itself in its slot while it records. trace_stop waits for all slots to drain before it frees the
+// buffers, the counters themselves are never freed so a thread may touch them without knowing whether a trace is
+// still running. slots are padded to a cache line each so recording threads don't share one.
+#define RECORDING_SLOT_COUNT 16
+static struct
+{
+  atomic_uint count;
+  char padding[64 - sizeof(atomic_uint)];
+} recording[RECORDING_SLOT_COUNT];
+static atomic_uint next_recording_slot;
+
+// threads only register once per trace, so a lock is cheap here. it keeps trace_stop from missing a buffer that is
+// registered while it takes the list.
+static mutex buffers_mutex = MUTEX_INITIALIZER;
+static trace_buffer *buffers;
+
+static THREAD_LOCAL trace_buffer *local_buffer;
+static THREAD_LOCAL unsigned local_generation;
+static THREAD_LOCAL unsigned local_recording_slot; // 1 based, 0 until the thread first records.
+
+static uint64_t now(void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (uint64_t) ((double) counter.QuadPart * 1e9 / (double) frequency.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+static trace_buffer *get_buffer(void)
+{
+  // buffers from a previous trace were freed by trace_stop, local_buffer is stale once the generation moved on.
+  unsigned current_generation = atomic_load(&generation);
+  if (local_buffer != NULL && local_generation == current_generation)
+    return local_buffer;
+
+  uint32_t capacity = atomic_load_explicit(&events_per_thread, memory_order_relaxed);
+  trace_buffer *buffer = (trace_buffer*) allocator_malloc(sizeof(trace_buffer) + capacity * sizeof(trace_event));
+  if (buffer == NULL)
+    return NULL;
+  buffer->thread_id = atomic_fetch_add(&next_thread_id, 1) + 1;
+  buffer->capacity = capacity;
+  atomic_init(&buffer->written, 0);
+
+  // a trace that stopped in the meantime must not get a buffer it will never collect.
+  mutex_lock(&buffers_mutex);
+  int registered = atomic_load(&enabled) && atomic_load(&generation) == current_generation;
+  if (registered)
+  {
+    buffer->next = buffers;
+    buffers = buffer;
+  }
+  mutex_unlock(&buffers_mutex);
+  if (!registered)
+  {
+    allocator_free(buffer);
+    return NULL;
+  }
+
+  local_buffer = buffer;
+  local_generation = current_generation;
+  return buffer;
+}
+
+static void record(const char *name, int64_t value, char phase)
+{
+  if (local_recording_slot == 0)
+    local_recording_slot = atomic_fetch_add(&next_recording_slot, 1) % RECORDING_SLOT_COUNT + 1;
+  atomic_uint *slot = &recording[local_recording_slot - 1].count;
+
+  // trace_stop bumps the generation before it reads the slots, and we count ourselves before we read the generation.
+  // so either get_buffer sees the new generation and won't touch the old buffer, or trace_stop sees us and waits.
+  atomic_fetch_add(slot, 1);
+  trace_buffer *buffer = get_buffer();
+  if (buffer == NULL)
+  {
+    atomic_fetch_sub_explicit(slot, 1, memory_order_release);
+    return;
+  }
+
+  uint64_t written = atomic_load_explicit(&buffer->written, memory_order_relaxed);
+  trace_event *event = &buffer->events[written % buffer->capacity];
+  event->timestamp = now();
+  event->name = name;
+  event->value = value;
+  event->phase = phase;
+  atomic_store_explicit(&buffer->written, written + 1, memory_order_release);
+  atomic_fetch_sub_explicit(slot, 1, memory_order_release);
+}
+
+int trace_start(uint32_t events_per_thread_count)
+{
+  if (events_per_thread_count == 0 || atomic_load(&enabled))
+    return -1;
+
+  atomic_store(&events_per_thread, events_per_thread_count);
+  atomic_fetch_add(&generation, 1);
+  atomic_store(&enabled, 1);
+  return 0;
+}
+
+int trace_enabled(void)
+{
+  return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
+
+void trace_begin(const char *name, int64_t value)
+{
+  record(name, value, 'B');
+}
+
+void trace_end(const char *name)
+{
+  record(name, -1, 'E');
+}
+
+int trace_stop(const char *path)
+{
+  if (!atomic_exchange(&enabled, 0))
+    return -1;
+
+  // take ownership of every buffer, threads re-register on the next trace.
+  mutex_lock(&buffers_mutex);
+  trace_buffer *list = buffers;
+  buffers = NULL;
+  atomic_fetch_add(&generation, 1);
+  mutex_unlock(&buffers_mutex);
+
+  // threads that passed trace_enabled() before the stop may still be writing their last event.
+  for (int i = 0; i < RECORDING_SLOT_COUNT; ++i)
+  {
+    while (atomic_load(&recording[i].count) != 0)
+      thread_yield();
+  }
+
+  FILE *file = path != NULL ? fopen(path, "w") : NULL;
+  if (file != NULL)
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+  int first = 1;
+  while (list != NULL)
+  {
+    trace_buffer *buffer = list;
+    list = list->next;
+
+    if (file != NULL)
+    {
+      // only the newest capacity events survive in the ring. spans nest per thread, so ends whose begin was
+      // overwritten are the ones seen while no span is open, they're dropped.
+      uint64_t written = atomic_load_explicit(&buffer->written, memory_order_acquire);
+      uint64_t start = written > buffer->capacity ? written - buffer->capacity : 0;
+      uint64_t open_spans = 0;
+      for (uint64_t i = start; i < written; ++i)
+      {
+        const trace_event *event = &buffer->events[i % buffer->capacity];
+        if (event->phase == 'E')
+        {
+          if (open_spans == 0)
+            continue;
+          --open_spans;
+        }
+        else
+          ++open_spans;
+
+        fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":1,\"tid\":%u",
+                first ? "" : ",", event->name, event->phase,
+                (unsigned long long) (event->timestamp / 1000), (unsigned) (event->timestamp % 1000), buffer->thread_id);
+        if (event->value >= 0)
+          fprintf(file, ",\"args\":{\"value\":%lld}", (long long) event->value);
+        fprintf(file, "}");
+        first = 0;
+      }
+    }
+
+    allocator_free(buffer);
+  }
+
+  if (file == NULL)
+    return -1;
+
+  fprintf(file, "\n]}\n");
+  fclose(file);
+  return 0;
+}
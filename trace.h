@@ -0,0 +1,33 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// opt-in timeline tracing, written out as chrome trace-event json (chrome://tracing, perfetto).
+// every thread records into its own fixed-size ring buffer, the oldest events are overwritten when it fills up.
+
+// starts recording, events_per_thread is the ring buffer size of every thread that records.
+int trace_start(uint32_t events_per_thread);
+// stops recording and writes the json to path. threads still recording are fine, their events from after the stop
+// are dropped.
+int trace_stop(const char *path);
+
+int trace_enabled(void);
+
+// names must outlive the trace (string literals), value is shown as the span's argument.
+void trace_begin(const char *name, int64_t value);
+void trace_end(const char *name);
+
+#define TRACE_BEGIN(name) do { if (trace_enabled()) trace_begin(name, -1); } while (0)
+#define TRACE_BEGIN_VALUE(name, value) do { if (trace_enabled()) trace_begin(name, value); } while (0)
+#define TRACE_END(name) do { if (trace_enabled()) trace_end(name); } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_H_